@@ -0,0 +1,556 @@
+#include <memory>
+#include <string>
+#include <cstring>       // for std::strerror
+#include <thread>
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <fstream>
+#include "bench_command_line_parameters.h"
+#include "original_word2vec_vocabulary.h"
+#include "original_word2vec_le_provider.h"
+#include "cbow_trainer_mikolov.h"
+#include "sg_trainer_mikolov.h"
+#include "model_loader.h"
+#include "snapshot_evaluator.h"
+
+
+// Набор микро- и макро-бенчмарков.
+// Результаты дописываются в файл в формате JSON lines (одна запись на измерение), чтобы отслеживать регрессии от коммита к коммиту.
+
+
+// запись результатов измерений
+class BenchReporter
+{
+public:
+  BenchReporter(const std::string& filename, const std::string& commitTag)
+  : commit(commitTag)
+  {
+    fo = fopen(filename.c_str(), "ab");
+    if ( fo == nullptr )
+      std::cerr << "Bench results file open: error: " << std::strerror(errno) << std::endl;
+  }
+  ~BenchReporter()
+  {
+    if (fo)
+      fclose(fo);
+  }
+  bool good() const
+  {
+    return fo != nullptr;
+  }
+  // сохранение одного измерения: набор именованных числовых величин (параметры и метрики)
+  void report(const std::string& suite, const std::string& name, const std::vector< std::pair<std::string, double> >& values)
+  {
+    fprintf(fo, "{\"commit\":\"%s\",\"suite\":\"%s\",\"name\":\"%s\"", commit.c_str(), suite.c_str(), name.c_str());
+    std::cout << "  " << suite << "/" << name << ":";
+    for (auto&& [key, value] : values)
+    {
+      fprintf(fo, ",\"%s\":%.6g", key.c_str(), value);
+      std::cout << "  " << key << "=" << value;
+    }
+    fprintf(fo, "}\n");
+    fflush(fo);
+    std::cout << std::endl;
+  }
+private:
+  FILE *fo = nullptr;
+  std::string commit;
+};
+
+
+// многократный запуск операции до накопления минимального времени измерения; результат -- наносекунд на одну элементарную операцию
+template <typename Operation>
+double measure_ns_per_op(Operation&& op, size_t ops_per_call, double min_seconds = 0.3)
+{
+  op(); // прогрев
+  size_t calls = 0;
+  auto start_tp = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::nano> elapsed(0);
+  do
+  {
+    op();
+    ++calls;
+    elapsed = std::chrono::steady_clock::now() - start_tp;
+  } while (elapsed.count() < min_seconds * 1e9);
+  return elapsed.count() / (calls * ops_per_call);
+}
+
+// приемник результатов вычислений, не позволяющий компилятору выбросить измеряемый код
+volatile double bench_sink = 0;
+
+
+// детерминированный генератор синтетического корпуса, частоты слов в котором подчиняются закону Ципфа;
+// одновременно строится словарь в формате build_dict
+void generate_zipf_corpus(const std::string& corpus_filename, const std::string& vocab_filename, size_t vocab_size, uint64_t words_count)
+{
+  std::vector<double> cdf(vocab_size);
+  double sum = 0;
+  for (size_t i = 0; i < vocab_size; ++i)
+  {
+    sum += 1.0 / (i + 1);
+    cdf[i] = sum;
+  }
+  std::vector<uint64_t> counts(vocab_size, 0);
+  uint64_t eol_count = 0;
+  std::mt19937_64 rng(1);  // алгоритм mt19937_64 строго специфицирован стандартом, поэтому корпус воспроизводим на любой платформе
+  FILE *fo = fopen(corpus_filename.c_str(), "wb");
+  uint64_t generated = 0;
+  while (generated < words_count)
+  {
+    size_t sentence_length = 5 + rng() % 26;
+    for (size_t w = 0; w < sentence_length; ++w)
+    {
+      double u = (rng() >> 11) * (1.0 / 9007199254740992.0) * sum;
+      size_t idx = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+      if (idx >= vocab_size) idx = vocab_size - 1;
+      ++counts[idx];
+      fprintf(fo, (w == 0) ? "w%zu" : " w%zu", idx);
+    }
+    fprintf(fo, "\n");
+    ++eol_count;
+    generated += sentence_length;
+  }
+  fclose(fo);
+  // словарь: маркер конца предложения, затем слова в порядке убывания частоты
+  std::vector<size_t> order(vocab_size);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&counts](size_t a, size_t b) { return counts[a] > counts[b]; });
+  fo = fopen(vocab_filename.c_str(), "wb");
+  fprintf(fo, "%s %lu\n", "</s>", eol_count);
+  for (auto&& idx : order)
+    if (counts[idx] > 0)
+      fprintf(fo, "w%zu %lu\n", idx, counts[idx]);
+  fclose(fo);
+}
+
+
+// детерминированный генератор синтетического корпуса со структурой, выявляемой аналогиями: слово t<i>r<j> обладает темой i
+// и ролью j; предложение посвящено паре (тема, роль), и каждое его слово разделяет с ней либо тему, либо роль (примесь --
+// служебные слова f<k>), так что вектор слова складывается из векторов темы и роли, и t<i>r<j> - t<i>r<k> + t<l>r<k> = t<l>r<j>;
+// частоты тем подчиняются закону Ципфа, так что слова большинства тем редки; одновременно строятся словарь в формате build_dict
+// и набор аналогий
+void generate_analogy_corpus(const std::string& corpus_filename, const std::string& vocab_filename, const std::string& analogy_filename,
+                             size_t topics, size_t roles, uint64_t words_count)
+{
+  const size_t fillers = 50;
+  std::vector<uint64_t> counts(topics * roles + fillers, 0);
+  auto word = [topics, roles](size_t idx) -> std::string {
+                return (idx < topics * roles) ? "t" + std::to_string(idx / roles) + "r" + std::to_string(idx % roles)
+                                              : "f" + std::to_string(idx - topics * roles);
+              };
+  std::vector<double> cdf(topics);
+  double sum = 0;
+  for (size_t i = 0; i < topics; ++i)
+  {
+    sum += 1.0 / (i + 1);
+    cdf[i] = sum;
+  }
+  auto zipf_topic = [&cdf, sum, topics](std::mt19937_64& rng) -> size_t {
+                      const double u = (rng() >> 11) * (1.0 / 9007199254740992.0) * sum;
+                      return std::min<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), topics - 1);
+                    };
+  uint64_t eol_count = 0;
+  std::mt19937_64 rng(2);
+  FILE *fo = fopen(corpus_filename.c_str(), "wb");
+  uint64_t generated = 0;
+  while (generated < words_count)
+  {
+    const size_t topic = zipf_topic(rng), role = rng() % roles;
+    size_t sentence_length = 8 + rng() % 8;
+    for (size_t w = 0; w < sentence_length; ++w)
+    {
+      const uint64_t kind = rng() % 10;
+      size_t idx;
+      if (kind < 2) idx = topics * roles + rng() % fillers;
+      else if (kind < 6) idx = topic * roles + rng() % roles;
+      else idx = zipf_topic(rng) * roles + role;
+      ++counts[idx];
+      fprintf(fo, (w == 0) ? "%s" : " %s", word(idx).c_str());
+    }
+    fprintf(fo, "\n");
+    ++eol_count;
+    generated += sentence_length;
+  }
+  fclose(fo);
+  std::vector<size_t> order(counts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&counts](size_t a, size_t b) { return counts[a] > counts[b]; });
+  fo = fopen(vocab_filename.c_str(), "wb");
+  fprintf(fo, "%s %lu\n", "</s>", eol_count);
+  for (auto&& idx : order)
+    if (counts[idx] > 0)
+      fprintf(fo, "%s %lu\n", word(idx).c_str(), counts[idx]);
+  fclose(fo);
+  // аналогии: a = (i, j), b = (i, k), c = (l, j), d = (l, k)
+  fo = fopen(analogy_filename.c_str(), "wb");
+  fprintf(fo, ": topic-role\n");
+  for (size_t q = 0; q < 1000; ++q)
+  {
+    const size_t i = rng() % topics, l = (i + 1 + rng() % (topics - 1)) % topics;
+    const size_t j = rng() % roles, k = (j + 1 + rng() % (roles - 1)) % roles;
+    fprintf(fo, "%s %s %s %s\n", word(i * roles + j).c_str(), word(i * roles + k).c_str(), word(l * roles + j).c_str(), word(l * roles + k).c_str());
+  }
+  fclose(fo);
+}
+
+
+// открывает доступ к таблице шума negative sampling для измерений
+class NegativeSamplingProbe : public SgTrainer_Mikolov
+{
+public:
+  using SgTrainer_Mikolov::SgTrainer_Mikolov;
+  // выбор n отрицательных примеров (в точности как в learning_model)
+  size_t draw(size_t n)
+  {
+    size_t acc = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      next_random_ns = next_random_ns * (unsigned long long)25214903917 + 11;
+      size_t target = table[(next_random_ns >> 16) % table_size];
+      if (target == 0) target = next_random_ns % (in_vocabulary->size() - 1) + 1;
+      acc += target;
+    }
+    return acc;
+  }
+  // повторное построение таблицы шума
+  void rebuild_table()
+  {
+    free(table);
+    InitUnigramTable_w();
+  }
+};
+
+
+// проверка соответствия токенизатора (read_word) эталонной побайтной реализации (read_word_bytewise) на обучающем множестве
+// и на порождаемом файле со всеми особыми случаями: CR внутри и вне слов, подряд идущие разделители и EOL, слова длиннее
+// MAX_STRING, слова на границах буфера чтения, отсутствие EOL в конце файла; также измеряет скорость обеих реализаций
+// возвращает количество расхождений
+uint64_t check_tokenizer(BenchReporter& reporter, const std::string& corpus_filename, const std::string& edge_filename)
+{
+  {
+    std::mt19937_64 rng(3);
+    const char alphabet[] = {'a', 'b', 'z', '0', '\xD0', '\xB0', ' ', '\t', '\n', '\r'};
+    FILE *fo = fopen(edge_filename.c_str(), "wb");
+    for (size_t i = 0; i < 3000000; )
+    {
+      // чередуем короткие и длинные (в том числе длиннее MAX_STRING) фрагменты
+      const size_t run = (rng() % 16 == 0) ? rng() % 300 : rng() % 12;
+      for (size_t k = 0; k < run; ++k, ++i)
+        fputc(alphabet[rng() % 6], fo);
+      const size_t delimiters = rng() % 4;
+      for (size_t k = 0; k < delimiters; ++k, ++i)
+        fputc(alphabet[6 + rng() % 4], fo);
+    }
+    fputs("tail", fo);  // последнее слово без EOL
+    fclose(fo);
+  }
+  uint64_t total_mismatches = 0;
+  for (int edge_cases = 0; edge_cases < 2; ++edge_cases)
+  {
+    const std::string& filename = edge_cases ? edge_filename : corpus_filename;
+    CorpusReader fast, reference;
+    fast.open(filename);
+    reference.open(filename);
+    std::string fast_word, reference_word;
+    uint64_t words = 0, mismatches = 0;
+    while (true)
+    {
+      read_word(fast, fast_word);
+      read_word_bytewise(reference, reference_word);
+      if (fast.eof() != reference.eof() || fast_word != reference_word)
+        ++mismatches;
+      if (fast.eof() || reference.eof()) break;
+      ++words;
+    }
+    reporter.report("micro", "tokenizer_conformance", { {"edge_cases", edge_cases}, {"words", words}, {"mismatches", mismatches} });
+    total_mismatches += mismatches;
+  }
+  // скорость токенизации без поиска в словаре
+  uint64_t words = 0;
+  std::string word;
+  for (int impl = 0; impl < 2; ++impl)
+  {
+    CorpusReader fin;
+    const double ns = measure_ns_per_op([&]() {
+                                          fin.open(corpus_filename);
+                                          words = 0;
+                                          while (true)
+                                          {
+                                            if (impl == 0) read_word_bytewise(fin, word); else read_word(fin, word);
+                                            if (fin.eof()) break;
+                                            ++words;
+                                          }
+                                        }, 1, 0.5);
+    reporter.report("micro", (impl == 0) ? "tokenize_bytewise" : "tokenize", { {"words", words}, {"ns_per_word", ns / std::max<uint64_t>(words, 1)} });
+  }
+  std::remove(edge_filename.c_str());
+  if (total_mismatches > 0)
+    std::cerr << "Tokenizer conformance check failed: " << total_mismatches << " mismatches" << std::endl;
+  return total_mismatches;
+}
+
+
+void run_micro(BenchReporter& reporter, const std::string& corpus_filename, const std::string& vocab_filename, size_t dim)
+{
+  std::mt19937_64 rng(2);
+  // ядра скалярного произведения и axpy (в той форме, в какой они используются в learning_model)
+  const size_t rows = 256;
+  std::vector<float> m(rows * dim);
+  for (auto& v : m) v = ((rng() & 0xFFFF) / 65536.0f - 0.5f) / dim;
+  std::vector<float> h(dim, 0.01f);
+  double ns = measure_ns_per_op([&]() {
+                                  double acc = 0;
+                                  for (size_t r = 0; r < rows; ++r)
+                                    acc += std::inner_product(h.data(), h.data()+dim, m.data()+r*dim, 0.0);
+                                  bench_sink = acc;
+                                }, rows);
+  reporter.report("micro", "dot", { {"dim", dim}, {"ns_per_op", ns} });
+  ns = measure_ns_per_op([&]() {
+                           const float g = 1e-6f;
+                           for (size_t r = 0; r < rows; ++r)
+                           {
+                             float *row = m.data()+r*dim;
+                             std::transform(row, row+dim, h.data(), row, [g](float a, float b) -> float {return a + g*b;});
+                           }
+                           bench_sink = m[0];
+                         }, rows);
+  reporter.report("micro", "axpy", { {"dim", dim}, {"ns_per_op", ns} });
+
+  // поиск индекса слова в словаре
+  auto vocabulary = std::make_shared< OriginalWord2VecVocabulary >();
+  if ( !vocabulary->load(vocab_filename) )
+    return;
+  std::vector<std::string> queries;
+  for (size_t i = 0; i < 4096; ++i)
+    queries.push_back( "w" + std::to_string(rng() % (vocabulary->size() * 2)) );  // примерно половина запросов -- несловарные слова
+  ns = measure_ns_per_op([&]() {
+                           size_t acc = 0;
+                           for (auto&& q : queries)
+                             acc += vocabulary->word_to_idx(q);
+                           bench_sink = acc;
+                         }, queries.size());
+  reporter.report("micro", "word_to_idx", { {"vocab", vocabulary->size()}, {"ns_per_op", ns} });
+
+  // чтение и токенизация обучающего множества (read_word + word_to_idx + subsampling)
+  for (float sample : {0.0f, 1e-3f})
+  {
+    OriginalWord2VecLearningExampleProvider provider(corpus_filename, 1, 5, sample, vocabulary);
+    uint64_t words_read = 0;
+    ns = measure_ns_per_op([&]() {
+                             provider.epoch_prepare(0);
+                             while ( provider.get(0) ) {}
+                             words_read = provider.getWordsCount(0);
+                             provider.epoch_unprepare(0);
+                           }, 1, 0.5);
+    reporter.report("micro", "read_tokenize", { {"sample", sample}, {"words", words_read}, {"ns_per_word", ns / std::max<uint64_t>(words_read, 1)} });
+  }
+
+  // решение о прореживании слова: исходная формула word2vec и таблица порогов
+  {
+    const float sample = 1e-3f;
+    const uint64_t train_words = vocabulary->cn_sum();
+    std::vector<word_index_t> ids(1 << 16);
+    for (auto& id : ids) id = rng() % vocabulary->size();
+    unsigned long long next_random = 1;
+    ns = measure_ns_per_op([&]() {
+                             size_t kept = 0;
+                             for (auto&& id : ids)
+                             {
+                               auto&& dict_word = vocabulary->idx_to_data(id);
+                               float ran = (sqrt(dict_word.cn / (sample * train_words)) + 1) * (sample * train_words) / dict_word.cn;
+                               next_random = next_random * (unsigned long long)25214903917 + 11;
+                               kept += !(ran < (next_random & 0xFFFF) / (float)65536);
+                             }
+                             bench_sink = kept;
+                           }, ids.size());
+    reporter.report("micro", "subsampling_formula", { {"ns_per_word", ns} });
+    SubsamplingTable subsampling;
+    subsampling.build(*vocabulary, sample, train_words);
+    ns = measure_ns_per_op([&]() {
+                             size_t kept = 0;
+                             for (auto&& id : ids)
+                             {
+                               next_random = next_random * (unsigned long long)25214903917 + 11;
+                               kept += !subsampling.discard(id, next_random);
+                             }
+                             bench_sink = kept;
+                           }, ids.size());
+    reporter.report("micro", "subsampling_table", { {"ns_per_word", ns} });
+  }
+
+  // negative sampling: построение таблицы шума и выбор отрицательных примеров
+  {
+    std::shared_ptr< CustomLearningExampleProvider> lep = std::make_shared< OriginalWord2VecLearningExampleProvider >(corpus_filename, 1, 5, 0, vocabulary);
+    NegativeSamplingProbe probe(lep, vocabulary, vocabulary, dim, 1, 0.025, "ns", 5);
+    ns = measure_ns_per_op([&]() { bench_sink = probe.draw(1 << 16); }, 1 << 16);
+    reporter.report("micro", "negative_draw", { {"vocab", vocabulary->size()}, {"ns_per_op", ns} });
+    ns = measure_ns_per_op([&]() { probe.rebuild_table(); }, 1, 1.0);
+    reporter.report("micro", "unigram_table_init", { {"vocab", vocabulary->size()}, {"ms", ns / 1e6} });
+  }
+
+  // построение дерева Хаффмана
+  ns = measure_ns_per_op([&]() { vocabulary->buildHuffmanTree(); }, 1, 1.0);
+  reporter.report("micro", "huffman_build", { {"vocab", vocabulary->size()}, {"ms", ns / 1e6} });
+}
+
+
+void run_macro(BenchReporter& reporter, const std::string& corpus_filename, const std::string& vocab_filename, const std::string& model_filename,
+               size_t dim, size_t epochs, size_t threads_count, size_t hot_rows, size_t prefetch)
+{
+  for (const std::string model : {"cbow", "skip-gram"})
+    for (const std::string optimization : {"ns", "hs"})
+    {
+      auto vocabulary = std::make_shared< OriginalWord2VecVocabulary >();
+      if ( !vocabulary->load(vocab_filename) )
+        return;
+      std::shared_ptr< CustomLearningExampleProvider> lep = std::make_shared< OriginalWord2VecLearningExampleProvider >(corpus_filename, threads_count, 5, 1e-3, vocabulary);
+      std::unique_ptr< CustomTrainer > trainer;
+      if (model == "cbow")
+        trainer = std::make_unique< CbowTrainer_Mikolov >(lep, vocabulary, vocabulary, dim, epochs, 0.05, optimization, 5);
+      else
+        trainer = std::make_unique< SgTrainer_Mikolov >(lep, vocabulary, vocabulary, dim, epochs, 0.025, optimization, 5);
+      trainer->set_hot_rows(hot_rows, 1000);
+      trainer->set_prefetch(prefetch);
+      trainer->init_net();
+      auto start_tp = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads_vec;
+      threads_vec.reserve(threads_count);
+      for (size_t i = 0; i < threads_count; ++i)
+        threads_vec.emplace_back(&CustomTrainer::train_entry_point, trainer.get(), i);
+      for (size_t i = 0; i < threads_count; ++i)
+        threads_vec[i].join();
+      std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start_tp;
+      std::cout << std::endl;
+      reporter.report("macro", model + "_" + optimization, { {"dim", dim}, {"threads", threads_count}, {"epochs", epochs}, {"hot_rows", hot_rows}, {"prefetch", prefetch},
+                                                             {"seconds", seconds.count()},
+                                                             {"words_per_sec", epochs * vocabulary->cn_sum() / seconds.count()} });
+      if (model == "cbow" && optimization == "ns")
+        trainer->saveEmbeddings(model_filename);
+    }
+
+  // задержка запроса к distance
+  std::vector<std::string> vocab;
+  float *embeddings = nullptr;
+  uint64_t words = 0, size = 0;
+  if ( !loadModel(model_filename, words, size, vocab, embeddings) )
+    return;
+  std::mt19937_64 rng(3);
+  std::vector<size_t> queries;
+  for (size_t i = 0; i < 64; ++i)
+    queries.push_back( rng() % words );
+  double ns = measure_ns_per_op([&]() {
+                                  size_t acc = 0;
+                                  for (auto&& q : queries)
+                                    acc += findNearest(embeddings, words, size, vocab, q, 40).size();
+                                  bench_sink = acc;
+                                }, queries.size());
+  reporter.report("macro", "distance_query", { {"words", words}, {"dim", size}, {"ms_per_query", ns / 1e6} });
+  free(embeddings);
+}
+
+
+// сравнение правил обновления весов по числу эпох, необходимых для достижения заданного качества: каждая модель обучается
+// заново на 1..max_epochs эпохах (расписание alpha зависит от их числа) и оценивается на аналогиях синтетического корпуса;
+// шаг AdaGrad уменьшается по мере накопления градиентов строки, поэтому его начальное значение alpha берется вчетверо большим
+void run_quality(BenchReporter& reporter, const std::string& workdir, size_t dim, size_t max_epochs, size_t threads_count, float target)
+{
+  const std::string corpus_filename = workdir + "/bench_quality_corpus.txt";
+  const std::string vocab_filename = workdir + "/bench_quality_corpus.vocab";
+  const std::string analogy_filename = workdir + "/bench_quality_analogy.txt";
+  generate_analogy_corpus(corpus_filename, vocab_filename, analogy_filename, 100, 10, 300000);
+  for (const std::string model : {"cbow", "skip-gram"})
+    for (const std::string optimizer : {"sgd", "adagrad"})
+    {
+      UpdateRule update_rule = urSgd;
+      if ( !parse_update_rule(optimizer, update_rule) )
+      {
+        std::cerr << "Unknown -optimizer value: " << optimizer << std::endl;
+        return;
+      }
+      const float alpha = ((model == "cbow") ? 0.05 : 0.025) * ((update_rule == urAdaGrad) ? 4 : 1);
+      size_t epochs_to_target = 0;
+      double seconds_to_target = 0;
+      for (size_t epochs = 1; epochs <= max_epochs; ++epochs)
+      {
+        auto vocabulary = std::make_shared< OriginalWord2VecVocabulary >();
+        if ( !vocabulary->load(vocab_filename) )
+          return;
+        std::shared_ptr< CustomLearningExampleProvider> lep = std::make_shared< OriginalWord2VecLearningExampleProvider >(corpus_filename, threads_count, 5, 1e-3, vocabulary);
+        std::unique_ptr< CustomTrainer > trainer;
+        if (model == "cbow")
+          trainer = std::make_unique< CbowTrainer_Mikolov >(lep, vocabulary, vocabulary, dim, epochs, alpha, "ns", 5);
+        else
+          trainer = std::make_unique< SgTrainer_Mikolov >(lep, vocabulary, vocabulary, dim, epochs, alpha, "ns", 5);
+        trainer->set_update_rule(update_rule);
+        trainer->init_net();
+        SnapshotEvaluator evaluator(*trainer, vocabulary->size(), 1);
+        if ( !evaluator.load_analogy(analogy_filename) )
+          return;
+        auto start_tp = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads_vec;
+        threads_vec.reserve(threads_count);
+        for (size_t i = 0; i < threads_count; ++i)
+          threads_vec.emplace_back(&CustomTrainer::train_entry_point, trainer.get(), i);
+        for (size_t i = 0; i < threads_count; ++i)
+          threads_vec[i].join();
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start_tp;
+        std::cout << std::endl;
+        const float accuracy = evaluator.analogy_score();
+        reporter.report("quality", model + "_" + optimizer, { {"dim", dim}, {"threads", threads_count}, {"alpha", alpha}, {"epochs", epochs},
+                                                              {"seconds", seconds.count()}, {"analogy", accuracy} });
+        if (accuracy >= target)
+        {
+          epochs_to_target = epochs;
+          seconds_to_target = seconds.count();
+          break;
+        }
+      }
+      // 0 -- качество не достигнуто за max_epochs эпох
+      reporter.report("quality", model + "_" + optimizer + "_to_target", { {"target", target}, {"epochs", epochs_to_target}, {"seconds", seconds_to_target} });
+    }
+  std::remove(corpus_filename.c_str());
+  std::remove(vocab_filename.c_str());
+  std::remove(analogy_filename.c_str());
+}
+
+
+int main(int argc, char **argv)
+{
+  // выполняем разбор параметров командной строки
+  BenchCommandLineParameters cmdLineParams;
+  cmdLineParams.parse(argc, argv);
+  cmdLineParams.dbg_cout();
+
+  BenchReporter reporter(cmdLineParams.getAsString("-output"), cmdLineParams.getAsString("-commit"));
+  if ( !reporter.good() )
+    return -1;
+
+  const std::string workdir = cmdLineParams.getAsString("-workdir");
+  const std::string corpus_filename = workdir + "/bench_corpus.txt";
+  const std::string vocab_filename = workdir + "/bench_corpus.vocab";
+  const std::string model_filename = workdir + "/bench_model.bin";
+  const std::string edge_filename = workdir + "/bench_tokenizer_edge.txt";
+  const std::string suite = cmdLineParams.getAsString("-suite");
+
+  std::cout << "Generating synthetic Zipfian corpus..." << std::endl;
+  generate_zipf_corpus(corpus_filename, vocab_filename, cmdLineParams.getAsInt("-vocab-size"), cmdLineParams.getAsInt("-corpus-words"));
+
+  uint64_t tokenizer_mismatches = 0;
+  if (suite == "micro" || suite == "all" || suite == "conformance")
+    tokenizer_mismatches = check_tokenizer(reporter, corpus_filename, edge_filename);
+  if (suite == "micro" || suite == "all")
+    run_micro(reporter, corpus_filename, vocab_filename, cmdLineParams.getAsInt("-size"));
+  if (suite == "macro" || suite == "all")
+    run_macro(reporter, corpus_filename, vocab_filename, model_filename,
+              cmdLineParams.getAsInt("-size"), cmdLineParams.getAsInt("-iter"), cmdLineParams.getAsInt("-threads"),
+              std::max(cmdLineParams.getAsInt("-hot-rows"), 0), std::max(cmdLineParams.getAsInt("-prefetch"), 0));
+  if (suite == "quality" || suite == "all")
+    run_quality(reporter, workdir, cmdLineParams.getAsInt("-size"), std::max(cmdLineParams.getAsInt("-quality-epochs"), 1),
+                cmdLineParams.getAsInt("-threads"), cmdLineParams.getAsFloat("-quality-target"));
+
+  std::remove(corpus_filename.c_str());
+  std::remove(vocab_filename.c_str());
+  std::remove(model_filename.c_str());
+  return (tokenizer_mismatches == 0) ? 0 : -1;
+}
@@ -0,0 +1,30 @@
+#ifndef BENCH_COMMAND_LINE_PARAMETERS_H_
+#define BENCH_COMMAND_LINE_PARAMETERS_H_
+
+#include "command_line_parameters.h"
+
+class BenchCommandLineParameters : public CommandLineParameters
+{
+public:
+  BenchCommandLineParameters()
+  {
+    // initialize params mapping with std::initialzer_list<T>
+    params_ = {
+        {"-output",       {"Append benchmark results (JSON lines) to <file>", "bench_results.json", std::nullopt}},
+        {"-commit",       {"Tag results with the given revision identifier", "unknown", std::nullopt}},
+        {"-suite",        {"Benchmarks to run: micro, macro, quality (epochs to target analogy accuracy, sgd vs adagrad), all or conformance (tokenizer check only)", "all", std::nullopt}},
+        {"-workdir",      {"Directory for temporary files (synthetic corpus, vocabulary, model)", ".", std::nullopt}},
+        {"-vocab-size",   {"Number of distinct words in the synthetic Zipfian corpus", "30000", std::nullopt}},
+        {"-corpus-words", {"Number of words in the synthetic Zipfian corpus", "2000000", std::nullopt}},
+        {"-size",         {"Set size of word vectors", "100", std::nullopt}},
+        {"-iter",         {"Training iterations for macro-benchmarks", "1", std::nullopt}},
+        {"-threads",      {"Use <int> threads for macro-benchmarks", "4", std::nullopt}},
+        {"-hot-rows",     {"Hot rows per weight matrix kept in thread-private copies during macro-benchmarks (0 = plain Hogwild)", "0", std::nullopt}},
+        {"-prefetch",     {"Prefetch depth (in learning examples) used during macro-benchmarks (0 = off)", "0", std::nullopt}},
+        {"-quality-epochs", {"Maximum number of epochs in quality benchmarks", "10", std::nullopt}},
+        {"-quality-target", {"Target analogy accuracy on the synthetic corpus in quality benchmarks", "0.9", std::nullopt}}
+    };
+  }
+};
+
+#endif /* BENCH_COMMAND_LINE_PARAMETERS_H_ */
@@ -2,43 +2,11 @@
 #include <cstring>       // for std::strerror
 #include <map>
 #include <unordered_map>
-#include "simple_profiler.h"
+#include "profiler.h"
 #include "build_dict_command_line_parameters.h"
-
-const size_t MAX_STRING = 100;
-
-// чтение одного слова из файла в предположении, что разделителями служат space + tab + EOL
-void read_word(FILE *fin, std::string& word)
-{
-  word.clear();
-  size_t a = 0;
-  while ( !feof(fin) )
-  {
-    int ch = fgetc(fin);
-    if (ch == 13) continue;   //  \r
-    if ((ch == ' ') || (ch == '\t') || (ch == '\n'))
-    {
-      // если есть прочитанный фрагмент слова
-      if (a > 0)
-      {
-        if (ch == '\n')
-          ungetc(ch, fin);
-        break;
-      }
-      // если прочитанного фрагмента слова нет
-      if (ch == '\n')
-      {
-        word = "</s>";
-        return;
-      }
-      else
-        continue;
-    } // if (delimiter) ...
-    if ( a < MAX_STRING )
-      word.push_back( ch );
-    ++a;
-  }
-} // method-end
+#include "corpus_reader.h"
+#include "tokenizer.h"
+#include "phrases.h"
 
 
 int main(int argc, char **argv)
@@ -53,79 +21,40 @@ int main(int argc, char **argv)
 
   SimpleProfiler global_profiler;
 
-  // открываем файл с тренировочными данными
-  FILE *fi = fopen(cmdLineParams.getAsString("-train").c_str(), "rb");
-  if ( fi == nullptr )
-  {
-    std::cerr << "Train-file open: error: " << std::strerror(errno) << std::endl;
+  // обучающее множество может состоять из нескольких, в том числе сжатых, файлов; оно делится на части для параллельной обработки
+  std::vector<std::string> train_files;
+  if ( !CorpusReader::list_files(cmdLineParams.getAsString("-train"), train_files) )
     return 0;
-  }
+  const size_t threads_count = std::max(cmdLineParams.getAsInt("-threads"), 1);
+  const std::vector<CorpusUnit> units = split_corpus(train_files, threads_count);
+  // ограничение количества записей таблиц частот (при превышении удаляются самые редкие записи)
+  const size_t max_entries = std::max(cmdLineParams.getAsInt("-max-entries"), 1);
 
-  // создаем контейенер для словаря
-  //std::map<std::string, uint64_t> dict;
-  std::unordered_map<std::string, uint64_t> dict;
-  // создаем счетчик для переводов строк
+  // создаем контейнер для словаря и счетчик для переводов строк
+  TokenCounter dict(max_entries);
   uint64_t eolCount = 0;
-  // создаем счетчик слов (для вывода прогресса)
-  uint64_t wordsCnt = 0;
-  // порог отсечения при сокращении словаря
-  size_t min_reduce = 1;
-  // читаем тренировочные данные
-  while (true)
+  if (cmdLineParams.isDefined("-phrases"))
   {
-    std::string word;
-    read_word(fi, word);
-    if (feof(fi)) break;
-    ++wordsCnt;
-    if (wordsCnt % 100000 == 0)
-    {
-      std::cout << '\r' << (wordsCnt / 1000) << " K     ";
-      std::cout.flush();
-    }
-    if (word == "</s>")
-    {
-      ++eolCount;
-      continue;
-    }
-    auto it = dict.find(word);
-    if (it == dict.end())
-      dict[word] = 1;
-    else
-      ++it->second;
-    if (dict.size() > 21000000)
-    {
-      std::cout << std::endl << "Reduce!" << std::endl;
-      auto it = dict.begin();
-      while (it != dict.end())    //TODO: в будущем заменить на std::experimental::erase_if (возможно на std::remove_if)
-      {
-        if (it->second > min_reduce)
-          ++it;
-        else
-          it = dict.erase(it);
-      }
-      ++min_reduce;
-    }
+    // выделение словосочетаний: словарь строится по переписанному обучающему множеству (см. phrases.h)
+    PhraseDetector detector(threads_count, max_entries, std::max(cmdLineParams.getAsInt("-phrase-min-count"), 1), cmdLineParams.getAsFloat("-phrase-threshold"));
+    detector.count(units);
+    if ( !detector.rewrite(units, cmdLineParams.getAsString("-phrases"), dict, eolCount) )
+      return -1;
   }
-  fclose(fi);
+  else
+    count_tokens(units, threads_count, max_entries, dict, eolCount);
   // выполняем отсечение по min-count
   size_t min_count = cmdLineParams.getAsInt("-min-count");
   std::cout << std::endl << "min-count reduce!" << std::endl;
-  auto it = dict.begin();
-  while (it != dict.end())    //TODO: в будущем заменить на std::experimental::erase_if (возможно на std::remove_if)
-  {
-    if (it->second >= min_count)
-      ++it;
-    else
-      it = dict.erase(it);
-  }
-  wordsCnt = eolCount;
-  for (auto& i : dict)
+  dict.prune(min_count);
+  uint64_t wordsCnt = eolCount;
+  for (auto& i : dict.counts())
     wordsCnt += i.second;
-  std::cout << "Vocab size: " << (dict.size() + 1) << std::endl;
+  std::cout << "Vocab size: " << (dict.counts().size() + 1) << std::endl;
   std::cout << "Words in train file: " << wordsCnt << std::endl;
   // пересортируем в порядке убывания частоты
   std::multimap<uint64_t, std::string> revDict;
-  for (auto& i : dict)
+  for (auto& i : dict.counts())
     revDict.insert( std::pair<uint64_t, std::string>(i.second, i.first) );
   // сохраняем словарь в файл
   FILE *fo = fopen(cmdLineParams.getAsString("-save-vocab").c_str(), "wb");
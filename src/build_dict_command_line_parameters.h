@@ -12,7 +12,12 @@ public:
     params_ = {
         {"-save-vocab",   {"The vocabulary will be saved to <file>", std::nullopt, std::nullopt}},
         {"-min-count",    {"This will discard words that appear less than <int> times", "100", std::nullopt}},
-        {"-train",        {"Use text data from <file> to train the model", std::nullopt, std::nullopt}}
+        {"-train",        {"Use text data from <file> to train the model", std::nullopt, std::nullopt}},
+        {"-threads",      {"Use <int> threads", "12", std::nullopt}},
+        {"-max-entries",  {"Keep at most <int> counted words (and bigrams) in memory; the rarest are pruned when exceeded (the limit is split between threads and each thread prunes by its own counts, so with several threads pruning is more aggressive and the result may depend on -threads)", "21000000", std::nullopt}},
+        {"-phrases",      {"Detect phrases (word2phrase): write the corpus with frequent bigrams joined by '_' to <file> and build the vocabulary from it", std::nullopt, std::nullopt}},
+        {"-phrase-min-count", {"Words and bigrams that appear less than <int> times are not joined into phrases", "5", std::nullopt}},
+        {"-phrase-threshold", {"Join a bigram if its score is above <float> (higher values give fewer phrases)", "100", std::nullopt}}
     };
   }
 };
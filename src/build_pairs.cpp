@@ -0,0 +1,107 @@
+#include <string>
+#include <cstring>       // for std::strerror
+#include <vector>
+#include <limits>
+#include "profiler.h"
+#include "build_pairs_command_line_parameters.h"
+#include "original_word2vec_vocabulary.h"
+#include "pairs_file_le_provider.h"
+#include "corpus_reader.h"
+#include "tokenizer.h"
+
+
+// Перевод текстового файла пар (слово, контекст) в бинарный формат, читаемый cbow/skip-gram с параметром -ctx-vocab
+// (см. pairs_file_le_provider.h). Пары, слово или контекст которых отсутствует в словаре, отбрасываются.
+// Словарь контекстов строится утилитой build_dict по столбцу контекстов.
+int main(int argc, char **argv)
+{
+  // выполняем разбор параметров командной строки
+  BuildPairsCommandLineParameters cmdLineParams;
+  cmdLineParams.parse(argc, argv);
+  cmdLineParams.dbg_cout();
+
+  if (!cmdLineParams.isDefined("-train") || !cmdLineParams.isDefined("-words-vocab") || !cmdLineParams.isDefined("-ctx-vocab") || !cmdLineParams.isDefined("-output"))
+    return 0;
+
+  SimpleProfiler global_profiler;
+
+  // загрузка словарей
+  OriginalWord2VecVocabulary words_vocabulary, contexts_vocabulary;
+  if ( !words_vocabulary.load( cmdLineParams.getAsString("-words-vocab") ) || !contexts_vocabulary.load( cmdLineParams.getAsString("-ctx-vocab") ) )
+    return -1;
+  if ( words_vocabulary.size() > std::numeric_limits<uint32_t>::max() || contexts_vocabulary.size() > std::numeric_limits<uint32_t>::max() )
+  {
+    std::cerr << "Vocabulary is too large for 32-bit indices" << std::endl;
+    return -1;
+  }
+
+  CorpusReader fi;
+  if ( !fi.open(cmdLineParams.getAsString("-train")) )
+  {
+    std::cerr << "Train-file open: error" << std::endl;
+    return -1;
+  }
+  FILE *fo = fopen(cmdLineParams.getAsString("-output").c_str(), "wb");
+  if ( fo == nullptr )
+  {
+    std::cerr << "Output-file open: error: " << std::strerror(errno) << std::endl;
+    return -1;
+  }
+  // заголовок записывается повторно, когда станет известно количество пар
+  PairsFileHeader header;
+  memcpy(header.magic, PAIRS_FILE_MAGIC, sizeof(header.magic));
+  header.words_vocab_size = words_vocabulary.size();
+  header.contexts_vocab_size = contexts_vocabulary.size();
+  header.pairs_count = 0;
+  fwrite(&header, sizeof(header), 1, fo);
+
+  uint64_t linesCnt = 0, skippedCnt = 0;
+  std::vector<uint32_t> buffer;
+  buffer.reserve(PAIRS_READ_BUFFER * 2);
+  std::string word, context, tail;
+  while (true)
+  {
+    read_word(fi, word);
+    if (fi.eof()) break;
+    if (word == "</s>") continue;  // пустая строка
+    read_word(fi, context);
+    // остаток строки (если он есть) игнорируем
+    if (context != "</s>")
+      do { read_word(fi, tail); } while ( !fi.eof() && tail != "</s>" );
+    ++linesCnt;
+    if (linesCnt % 1000000 == 0)
+    {
+      std::cout << '\r' << (linesCnt / 1000000) << " M     ";
+      std::cout.flush();
+    }
+    const word_index_t wordIdx = words_vocabulary.word_to_idx(word);
+    const word_index_t ctxIdx = (context != "</s>") ? contexts_vocabulary.word_to_idx(context) : NO_WORD_INDEX;
+    if (wordIdx == NO_WORD_INDEX || ctxIdx == NO_WORD_INDEX)
+    {
+      ++skippedCnt;
+      continue;
+    }
+    buffer.push_back(static_cast<uint32_t>(wordIdx));
+    buffer.push_back(static_cast<uint32_t>(ctxIdx));
+    ++header.pairs_count;
+    if (buffer.size() == buffer.capacity())
+    {
+      fwrite(buffer.data(), sizeof(uint32_t), buffer.size(), fo);
+      buffer.clear();
+    }
+  }
+  fwrite(buffer.data(), sizeof(uint32_t), buffer.size(), fo);
+  fi.close();
+  fseek(fo, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, fo);
+  if ( ferror(fo) )
+  {
+    std::cerr << "Output-file write: error: " << std::strerror(errno) << std::endl;
+    fclose(fo);
+    return -1;
+  }
+  fclose(fo);
+  std::cout << std::endl << "Pairs written: " << header.pairs_count << ", skipped (out of vocabulary): " << skippedCnt << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef BUILD_PAIRS_COMMAND_LINE_PARAMETERS_H_
+#define BUILD_PAIRS_COMMAND_LINE_PARAMETERS_H_
+
+#include "command_line_parameters.h"
+
+class BuildPairsCommandLineParameters : public CommandLineParameters
+{
+public:
+  BuildPairsCommandLineParameters()
+  {
+    // initialize params mapping with std::initialzer_list<T>
+    params_ = {
+        {"-train",        {"Read (word, context) pairs from text <file>, one 'word context' pair per line", std::nullopt, std::nullopt}},
+        {"-words-vocab",  {"The words vocabulary will be read from <file>", std::nullopt, std::nullopt}},
+        {"-ctx-vocab",    {"The contexts vocabulary will be read from <file>", std::nullopt, std::nullopt}},
+        {"-output",       {"Save the binary pairs file (input for cbow/skip-gram with -ctx-vocab) to <file>", std::nullopt, std::nullopt}}
+    };
+  }
+};
+
+#endif /* BUILD_PAIRS_COMMAND_LINE_PARAMETERS_H_ */
@@ -0,0 +1,163 @@
+#ifndef CAPACITY_PLANNER_H_
+#define CAPACITY_PLANNER_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include "trainer.h"
+
+
+// Планирование ресурсов обучения (-dry-run).
+// До выделения весовых матриц выводится расчет потребности в памяти по статьям (матрицы весов, таблица шума, словари с хэш-индексом,
+// коды и пути дерева Хаффмана, буферы поставщика обучающих примеров и потоков) -- с учетом формата весов, размещения в файлах,
+// огромных страниц и накладных расходов распределителя памяти (glibc). Затем (при ненулевой длительности калибровки) нейросеть
+// инициализируется, и заданное количество потоков несколько секунд обучается на начале обучающего множества; по измеренной
+// скорости оценивается время обучения на заданном количестве эпох. Результат калибровочного прогона не сохраняется.
+
+
+class CapacityPlanner
+{
+public:
+  // конструктор; threadsCount -- количество потоков обучения
+  CapacityPlanner(CustomTrainer& planned_trainer, size_t threadsCount)
+  : trainer(planned_trainer)
+  , threads_count(threadsCount)
+  {
+  }
+  // вывод расчета потребности в памяти (до вызова init_net); false, если расчет превышает доступную память
+  bool print_memory_plan() const
+  {
+    uint64_t transient_bytes = 0;
+    const std::vector<CustomTrainer::MemoryPlanItem> plan = trainer.memory_plan(threads_count, transient_bytes);
+    uint64_t total = 0;
+    std::cout << "Memory plan (threads: " << threads_count << "):" << std::endl;
+    for (auto&& item : plan)
+    {
+      print_line(item.name, item.bytes, item.note);
+      total += item.bytes;
+    }
+    print_line("total", total, "");
+    if (transient_bytes > 0)
+      print_line("peak", total + transient_bytes, "while the huffman tree is built");
+    uint64_t available = 0;
+    if ( !available_bytes(available) ) return true;
+    print_line("available on host", available, "MemAvailable");
+    if (total + transient_bytes > available)
+    {
+      std::cout << "Warning: the planned memory exceeds the memory available on host" << std::endl;
+      return false;
+    }
+    return true;
+  } // method-end
+  // калибровочный прогон: обучение в threads_count потоках в течение seconds секунд (после init_net);
+  // возвращает измеренную скорость обучения (слов в секунду суммарно по всем потокам)
+  double calibrate(double seconds)
+  {
+    std::cout << "Calibrating throughput for " << seconds << " seconds..." << std::endl;
+    std::atomic<size_t> finished_threads(0);
+    const std::chrono::steady_clock::time_point calibration_start_tp = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point calibration_end_tp = calibration_start_tp +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    std::vector<std::thread> threads_vec;
+    threads_vec.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i)
+      threads_vec.emplace_back([this, i, &finished_threads]()
+                               {
+                                 trainer.train_entry_point(i);
+                                 ++finished_threads;
+                               });
+    while (finished_threads.load() < threads_count && std::chrono::steady_clock::now() < calibration_end_tp)
+      std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+    completed = (finished_threads.load() == threads_count);
+    trainer.request_stop();
+    for (auto& thread : threads_vec)
+      thread.join();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - calibration_start_tp).count();
+    uint64_t words = 0;
+    for (auto&& thread_words : trainer.status().thread_words)
+      words += thread_words;
+    measured_seconds = elapsed;
+    words_per_second = (elapsed > 0) ? words / elapsed : 0;
+    std::cout << std::endl << "Calibration: " << words << " words in " << std::fixed << std::setprecision(1) << elapsed << " s, "
+              << std::setprecision(2) << words_per_second / 1000 << "k words/sec" << std::defaultfloat << std::endl;
+    if (completed)
+      std::cout << "Training completed during calibration: the estimate below is the actual training time" << std::endl;
+    return words_per_second;
+  } // method-end
+  // вывод оценки полного времени работы: startup_seconds -- время загрузки данных и инициализации нейросети,
+  // with_backup -- будет сохранена резервная копия, time_budget -- ограничение времени (-time-budget; <= 0 -- не задано)
+  void print_time_estimate(double startup_seconds, bool with_backup, double time_budget) const
+  {
+    const uint64_t words = trainer.planned_words();
+    const double training_seconds = completed ? measured_seconds : ((words_per_second > 0) ? words / words_per_second : 0);
+    const double save_seconds = trainer.estimated_save_seconds(with_backup);
+    const double total = startup_seconds + training_seconds + save_seconds;
+    std::cout << std::fixed << std::setprecision(1) << "Estimated wall time: startup " << startup_seconds << " s + training "
+              << training_seconds << " s (" << words << " words) + saving " << save_seconds << " s = " << total << " s ("
+              << format_duration(total) << ")" << std::defaultfloat << std::endl;
+    if (time_budget > 0 && total > time_budget)
+    {
+      const double coverage = std::max(time_budget - startup_seconds - save_seconds, 0.0) / std::max(training_seconds, 1e-9);
+      std::cout << std::fixed << std::setprecision(1) << "Time budget of " << time_budget << " s is not enough: about "
+                << std::min(coverage, 1.0) * 100 << "% of the planned words will be processed" << std::defaultfloat << std::endl;
+    }
+  } // method-end
+private:
+  // периодичность проверки окончания калибровочного прогона
+  static const int POLL_INTERVAL_MS = 50;
+  CustomTrainer& trainer;
+  size_t threads_count;
+  // результаты калибровочного прогона
+  double words_per_second = 0;
+  double measured_seconds = 0;
+  bool completed = false;   // обучение завершилось до истечения времени калибровки
+
+  static void print_line(const std::string& name, uint64_t bytes, const std::string& note)
+  {
+    std::cout << "  " << std::left << std::setw(28) << name << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+              << bytes / 1048576.0 << " MB" << std::defaultfloat;
+    if (!note.empty())
+      std::cout << "  (" << note << ")";
+    std::cout << std::endl;
+  }
+  // объем памяти, доступной для новых процессов без вытеснения в своп (MemAvailable); false, если сведения недоступны
+  static bool available_bytes(uint64_t& bytes)
+  {
+#ifdef __linux__
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while ( std::getline(meminfo, line) )
+    {
+      std::istringstream fields(line);
+      std::string key;
+      uint64_t kb = 0;
+      if ( (fields >> key >> kb) && key == "MemAvailable:" )
+      {
+        bytes = kb * 1024;
+        return true;
+      }
+    }
+#endif
+    return false;
+  } // method-end
+  static std::string format_duration(double seconds)
+  {
+    const uint64_t s = static_cast<uint64_t>(seconds + 0.5);
+    std::ostringstream out;
+    if (s >= 3600) out << s / 3600 << "h ";
+    if (s >= 60) out << (s % 3600) / 60 << "m ";
+    out << s % 60 << "s";
+    return out.str();
+  }
+}; // class-decl-end
+
+
+#endif /* CAPACITY_PLANNER_H_ */
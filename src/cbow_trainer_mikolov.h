@@ -21,90 +21,165 @@ public:
                float learning_rate = 0.05,
                const std::string& optimization = "ns",
                size_t negative_count = 5 )
-  : CustomTrainer(learning_example_provider, words_vocabulary, contexts_vocabulary, contexts_vocabulary, words_vocabulary, embedding_size, epochs, learning_rate, optimization, negative_count)
+  : CustomTrainer(learning_example_provider, words_vocabulary, contexts_vocabulary, words_vocabulary, contexts_vocabulary, embedding_size, epochs, learning_rate, optimization, negative_count)
   {
+    // входной словарь -- словарь слов (сохраняются вектора слов), отрицательные примеры выбираются из словаря контекстов
+    // (при общем словаре он совпадает со словарем слов, и модель совпадает с оригинальной cbow)
     if (optimization_algo == loaNegativeSampling)
-      InitUnigramTable_w();
+      InitUnigramTable_c();
   }
   // деструктор
   virtual ~CbowTrainer_Mikolov()
   {
   }
   // функция, реализующая модель обучения cbow
-  void learning_model(const LearningExample& le, float *neu1, float *neu1e)
+  void learning_model(const LearningExample& le, float *neu1, float *neu1e, HotRows& hot_rows, LossAccumulator *loss)
+  {
+    switch (precision)
+    {
+      case wpFloat32:  learning_model_impl(le, neu1, neu1e, hot_rows, syn0, syn1, loss); break;
+      case wpBFloat16: learning_model_impl(le, neu1, neu1e, hot_rows, reinterpret_cast<bf16_t*>(syn0), reinterpret_cast<bf16_t*>(syn1), loss); break;
+      case wpFloat16:  learning_model_impl(le, neu1, neu1e, hot_rows, reinterpret_cast<fp16_t*>(syn0), reinterpret_cast<fp16_t*>(syn1), loss); break;
+    }
+  } // method-end
+  // упреждающая загрузка в кэш строк, нужных для обработки обучающего примера: входных векторов и выходных строк (узлов путей)
+  void prefetch_example(const LearningExample& le)
+  {
+    const bool predict_contexts = (w_vocabulary != c_vocabulary);
+    if (predict_contexts)
+      prefetch_matrix_row(syn0, le.word);
+    else
+      for (auto&& ctx_idx : le.context)
+        prefetch_matrix_row(syn0, ctx_idx);
+    auto prefetch_output = [this](word_index_t idx) {
+                             if (optimization_algo == loaHierarchicalSoftmax)
+                               prefetch_huffman_path(idx);
+                             else
+                               prefetch_matrix_row(syn1, idx);
+                           };
+    if (predict_contexts)
+      for (auto&& ctx_idx : le.context)
+        prefetch_output(ctx_idx);
+    else
+      prefetch_output(le.word);
+  }
+private:
+  // модель обучения cbow для заданного формата хранения весов T
+  template <typename T>
+  void learning_model_impl(const LearningExample& le, float *neu1, float *neu1e, HotRows& hot_rows, T *w0, T *w1, LossAccumulator *loss)
   {
     if (le.context.size() == 0) return;
+    profile_section(psComputeForward);
+    // при общем словаре (оригинальный word2vec) на вход подаются слова контекста и предсказывается слово;
+    // при отдельном словаре контекстов на вход подается слово (его вектор и есть результат обучения) и предсказываются его контексты
+    const bool predict_contexts = (w_vocabulary != c_vocabulary);
+    const word_index_t *inputs = predict_contexts ? &le.word : le.context.data();
+    const size_t inputs_count = predict_contexts ? 1 : le.context.size();
+    const word_index_t *targets = predict_contexts ? le.context.data() : &le.word;
+    const size_t targets_count = predict_contexts ? le.context.size() : 1;
     // зануляем текущие значения выходов нейронов скрытого слоя и текущие значения ошибок
     std::fill(neu1, neu1+layer1_size, 0.0);
     std::fill(neu1e, neu1e+layer1_size, 0.0);
     // вычисляем выход скрытого слоя ( in --> hidden )
-    // в cbow он вычисляется как "средний" вектор слов контекста (так называемый "проекционный" слой)
-    for (auto&& ctx_idx : le.context)  // складываем все вектора слов контекста
-      std::transform(neu1, neu1+layer1_size, syn0+ctx_idx*layer1_size, neu1, std::plus<float>());
-    std::transform(neu1, neu1+layer1_size, neu1, std::bind(std::divides<float>(), std::placeholders::_1, le.context.size())); // нормируем по числу слов контекста
-    //
-    if (optimization_algo == loaHierarchicalSoftmax)  // hierarchical softmax
-    {
-      auto&& current_word_data = w_vocabulary->idx_to_data(le.word);
-      const size_t huffman_code_len = current_word_data.huffman_code_float.size();
-      for (size_t d = 0; d < huffman_code_len; ++d)
-      {
-        // вычисляем смещение вектора, соответствующего очередному узлу в дереве Хаффмана
-        float *nodeVectorPtr = syn1 + current_word_data.huffman_path[d] * layer1_size;
-        // вычисляем выход соответствующего нейрона выходного слоя (hidden -> output)
-        // он вычисляется как сигма-функция от скалярного произведения векторов: весового вектора, соответствующего текущему узлу в дереве Хаффмана, и вектора, соответствующего выходу скрытого слоя
-        //float f = std::transform_reduce(std::execution::par, neu1, neu1+layer1_size, nodeVectorPtr, 0.0, std::plus<>(), std::multiplies<>());
-        float f = std::inner_product(neu1, neu1+layer1_size, nodeVectorPtr, 0.0);
-        if (f <= -MAX_EXP || f >= MAX_EXP) continue;
-        else f = expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
-        // 'g' is the gradient multiplied by the learning rate
-        float g = (1.0 - current_word_data.huffman_code_float[d] - f) * alpha;
-        // Propagate errors output -> hidden
-        std::transform(neu1e, neu1e+layer1_size, nodeVectorPtr, neu1e, [g](float a, float b) -> float {return a + g*b;});
-        // Learn weights hidden -> output
-        std::transform(nodeVectorPtr, nodeVectorPtr+layer1_size, neu1, nodeVectorPtr, [g](float a, float b) -> float {return a + g*b;});
-      }
-    }
-    else if (optimization_algo == loaNegativeSampling) // negative sampling
+    // в cbow он вычисляется как "средний" вектор входных слов (так называемый "проекционный" слой)
+    for (size_t i = 0; i < inputs_count; ++i)  // складываем все входные вектора
+      add_row(neu1, hot_rows.in.row(w0, inputs[i]), layer1_size);
+    std::transform(neu1, neu1+layer1_size, neu1, std::bind(std::divides<float>(), std::placeholders::_1, inputs_count)); // нормируем по числу входных слов
+    // при AdaGrad g -- градиент без коэффициента скорости обучения, а шаг каждой строки вычисляется по её накопителю
+    const bool adagrad = (update_rule == urAdaGrad);
+    const float g_scale = gradient_scale();
+    const float neu1_sq = adagrad ? dot_row(neu1, neu1, layer1_size) : 0;
+    // цикл по предсказываемым словам (ошибка скрытого слоя накапливается по всем и применяется к входным векторам однократно)
+    for (size_t t = 0; t < targets_count; ++t)
     {
-      size_t target;
-      int label; // знаковое целое (!)
-      float g = 0.0;
-      for (size_t d = 0; d <= negative; ++d)
+      const word_index_t output_idx = targets[t];
+      if (optimization_algo == loaHierarchicalSoftmax)  // hierarchical softmax
       {
-        if (d == 0) // на первой итерации рассматриваем положительный пример
+        auto&& current_word_data = out_vocabulary->idx_to_data(output_idx);
+        const size_t huffman_code_len = current_word_data.huffman_code_float.size();
+        for (size_t d = 0; d < huffman_code_len; ++d)
         {
-          target = le.word;
-          label = 1;
+          profile_section(psComputeForward);
+          // вычисляем смещение вектора, соответствующего очередному узлу в дереве Хаффмана
+          T *nodeVectorPtr = hot_rows.out.row(w1, current_word_data.huffman_path[d]);
+          // вычисляем выход соответствующего нейрона выходного слоя (hidden -> output)
+          // он вычисляется как сигма-функция от скалярного произведения векторов: весового вектора, соответствующего текущему узлу в дереве Хаффмана, и вектора, соответствующего выходу скрытого слоя
+          //float f = std::transform_reduce(std::execution::par, neu1, neu1+layer1_size, nodeVectorPtr, 0.0, std::plus<>(), std::multiplies<>());
+          float f = dot_row(neu1, nodeVectorPtr, layer1_size);
+          profile_count(pcDots);
+          if (loss)
+          {
+            loss->sum += logistic_loss(f, current_word_data.huffman_code_float[d] == 0);
+            ++loss->count;
+          }
+          if (f <= -MAX_EXP || f >= MAX_EXP) continue;
+          else f = expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
+          // 'g' is the gradient multiplied by the learning rate
+          float g = (1.0 - current_word_data.huffman_code_float[d] - f) * g_scale;
+          profile_section(psComputeBackward);
+          // Propagate errors output -> hidden
+          axpy_row(neu1e, g, nodeVectorPtr, layer1_size);
+          // Learn weights hidden -> output
+          update_row(nodeVectorPtr, adagrad ? g * adagrad_rate(adagrad_syn1, current_word_data.huffman_path[d], g * g * neu1_sq) : g, neu1, layer1_size);
         }
-        else // на остальных итерациях рассматриваем отрицательные примеры (шум)
+      }
+      else if (optimization_algo == loaNegativeSampling) // negative sampling
+      {
+        word_index_t target;
+        int label; // знаковое целое (!)
+        float g = 0.0;
+        // отрицательный пример выбирается на шаг раньше его обработки (последовательность выбора от этого не меняется),
+        // чтобы при упреждающей выборке его строка загружалась в кэш во время обработки предыдущего примера
+        word_index_t next_negative = (negative > 0) ? draw_negative(out_vocabulary->size()) : 0;
+        for (size_t d = 0; d <= negative; ++d)
         {
-          next_random_ns = next_random_ns * (unsigned long long)25214903917 + 11;
-          target = table[(next_random_ns >> 16) % table_size];
-          if (target == 0) target = next_random_ns % (w_vocabulary->size() - 1) + 1;
-          if (target == le.word) continue;
-          label = 0;
+          profile_section(psComputeForward);
+          if (d == 0) // на первой итерации рассматриваем положительный пример
+          {
+            target = output_idx;
+            label = 1;
+          }
+          else // на остальных итерациях рассматриваем отрицательные примеры (шум)
+          {
+            target = next_negative;
+            if (d < negative)
+              next_negative = draw_negative(out_vocabulary->size());
+            if (target == output_idx) continue;
+            label = 0;
+          }
+          // вычисляем смещение вектора, соответствующего очередному положительному/отрицательному примеру
+          T *targetVectorPtr = hot_rows.out.row(w1, target);
+          // вычисляем выход соответствующего нейрона выходного слоя (hidden -> output)
+          float f = dot_row(neu1, targetVectorPtr, layer1_size);
+          profile_count(pcDots);
+          if (loss)
+          {
+            loss->sum += logistic_loss(f, label);
+            ++loss->count;
+          }
+          // вычислим градиент умноженный на коэффициент скорости обучения
+          if (f > MAX_EXP) g = (label - 1) * g_scale;
+          else if (f < -MAX_EXP) g = (label - 0) * g_scale;
+          else g = (label - expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))]) * g_scale;
+          profile_section(psComputeBackward);
+          // Propagate errors output -> hidden
+          axpy_row(neu1e, g, targetVectorPtr, layer1_size);
+          // Learn weights hidden -> output
+          update_row(targetVectorPtr, adagrad ? g * adagrad_rate(adagrad_syn1, target, g * g * neu1_sq) : g, neu1, layer1_size);
         }
-        // вычисляем смещение вектора, соответствующего очередному положительному/отрицательному примеру
-        float *targetVectorPtr = syn1 + target * layer1_size;
-        // вычисляем выход соответствующего нейрона выходного слоя (hidden -> output)
-        float f = std::inner_product(neu1, neu1+layer1_size, targetVectorPtr, 0.0);
-        // вычислим градиент умноженный на коэффициент скорости обучения
-        if (f > MAX_EXP) g = (label - 1) * alpha;
-        else if (f < -MAX_EXP) g = (label - 0) * alpha;
-        else g = (label - expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))]) * alpha;
-        // Propagate errors output -> hidden
-        std::transform(neu1e, neu1e+layer1_size, targetVectorPtr, neu1e, [g](float a, float b) -> float {return a + g*b;});
-        // Learn weights hidden -> output
-        std::transform(targetVectorPtr, targetVectorPtr+layer1_size, neu1, targetVectorPtr, [g](float a, float b) -> float {return a + g*b;});
-      }
-    }
+      } // if (optimization_algo == ???) ... else ...
+    } // for all targets
     // коррекция весов между входным и скрытым слоем (обратное распространение ошибки на участке hidden -> in)
-    for (auto&& ctx_idx : le.context)
+    profile_section(psComputeBackward);
+    if (adagrad)
     {
-      size_t ctxOffset = ctx_idx * layer1_size;
-      std::transform(syn0+ctxOffset, syn0+ctxOffset+layer1_size, neu1e, syn0+ctxOffset, std::plus<float>());
+      const float neu1e_sq = dot_row(neu1e, neu1e, layer1_size);
+      for (size_t i = 0; i < inputs_count; ++i)
+        update_row(hot_rows.in.row(w0, inputs[i]), adagrad_rate(adagrad_syn0, inputs[i], neu1e_sq), neu1e, layer1_size);
     }
+    else
+      for (size_t i = 0; i < inputs_count; ++i)
+        add_to_row(hot_rows.in.row(w0, inputs[i]), neu1e, layer1_size);
   } // method-end
 }; // class-end
 
@@ -0,0 +1,37 @@
+#include <string>
+#include <iostream>
+#include "profiler.h"
+#include "coordinator_command_line_parameters.h"
+#include "parameter_averaging.h"
+
+
+// Координатор распределенного обучения: принимает подключения процессов cbow/skip-gram, запущенных с параметром -dist-coordinator,
+// и в каждом раунде синхронизации усредняет присланные ими приращения весовых матриц (см. parameter_averaging.h).
+// Завершает работу, когда все исполнители закончат обучение.
+int main(int argc, char **argv)
+{
+  // выполняем разбор параметров командной строки
+  CoordinatorCommandLineParameters cmdLineParams;
+  cmdLineParams.parse(argc, argv);
+  cmdLineParams.dbg_cout();
+
+  if (!cmdLineParams.isDefined("-workers"))
+    return 0;
+
+  SimpleProfiler global_profiler;
+
+  const int workers_count = cmdLineParams.getAsInt("-workers");
+  const int port = cmdLineParams.getAsInt("-port");
+  if (workers_count < 1 || port < 1 || port > 65535)
+  {
+    std::cerr << "Invalid -workers or -port value" << std::endl;
+    return -1;
+  }
+
+  ParameterAveragingCoordinator coordinator;
+  if ( !coordinator.accept_workers(port, workers_count) )
+    return -1;
+  if ( !coordinator.serve() )
+    return -1;
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef COORDINATOR_COMMAND_LINE_PARAMETERS_H_
+#define COORDINATOR_COMMAND_LINE_PARAMETERS_H_
+
+#include "command_line_parameters.h"
+
+class CoordinatorCommandLineParameters : public CommandLineParameters
+{
+public:
+  CoordinatorCommandLineParameters()
+  {
+    // initialize params mapping with std::initialzer_list<T>
+    params_ = {
+        {"-port",         {"Listen for workers on TCP port <int>", "7700", std::nullopt}},
+        {"-workers",      {"Number of worker processes (cbow or skip-gram started with -dist-coordinator)", std::nullopt, std::nullopt}}
+    };
+  }
+};
+
+#endif /* COORDINATOR_COMMAND_LINE_PARAMETERS_H_ */
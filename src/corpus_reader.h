@@ -0,0 +1,346 @@
+#ifndef CORPUS_READER_H_
+#define CORPUS_READER_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#ifdef _WIN32
+#include <filesystem>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+#ifdef W2V_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef W2V_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+
+// Последовательное чтение файла обучающего множества: обычного или сжатого (gzip -- при сборке с zlib, zstd -- при сборке с libzstd).
+// Формат определяется по сигнатуре в начале файла. Распаковка выполняется тем потоком управления, который читает файл,
+// поэтому сжатые части корпуса не требуется предварительно распаковывать на диск.
+// Чтение побайтное, с собственной буферизацией (без блокировок, которые выполняет fgetc).
+enum CorpusFileFormat
+{
+  cffPlain,
+  cffGzip,
+  cffZstd
+};
+
+
+class CorpusReader
+{
+public:
+  CorpusReader()
+  : buffer(READ_BUFFER_SIZE)
+  {
+  }
+  CorpusReader(const CorpusReader&) = delete;
+  CorpusReader& operator=(const CorpusReader&) = delete;
+  ~CorpusReader()
+  {
+    close();
+  }
+  // определение формата файла по сигнатуре
+  static CorpusFileFormat detect_format(const std::string& filename)
+  {
+    unsigned char magic[4] = {0, 0, 0, 0};
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (f == nullptr) return cffPlain;
+    const size_t n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    if (n >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) return cffGzip;
+    if (n >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) return cffZstd;
+    return cffPlain;
+  }
+  // открытие файла; offset -- позиция начала чтения (только для несжатых файлов)
+  bool open(const std::string& filename, uint64_t offset = 0)
+  {
+    close();
+    format = detect_format(filename);
+    if (format == cffPlain)
+    {
+      plain = fopen(filename.c_str(), "rb");
+      if (plain == nullptr)
+      {
+        std::cerr << "CorpusReader: can't open " << filename << ": " << std::strerror(errno) << std::endl;
+        return false;
+      }
+      if (offset > 0 && fseek(plain, offset, SEEK_SET) != 0)
+      {
+        std::cerr << "CorpusReader: can't seek in " << filename << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+      }
+    }
+    else if (format == cffGzip)
+    {
+#ifdef W2V_WITH_ZLIB
+      gz = gzopen(filename.c_str(), "rb");
+      if (gz == nullptr)
+      {
+        std::cerr << "CorpusReader: can't open " << filename << std::endl;
+        return false;
+      }
+      gzbuffer(gz, READ_BUFFER_SIZE);
+#else
+      std::cerr << "CorpusReader: " << filename << " is gzip-compressed, but w2vxx was built without zlib" << std::endl;
+      return false;
+#endif
+    }
+    else
+    {
+#ifdef W2V_WITH_ZSTD
+      plain = fopen(filename.c_str(), "rb");
+      if (plain == nullptr)
+      {
+        std::cerr << "CorpusReader: can't open " << filename << ": " << std::strerror(errno) << std::endl;
+        return false;
+      }
+      zstd = ZSTD_createDStream();
+      ZSTD_initDStream(zstd);
+      zstd_input.resize(ZSTD_DStreamInSize());
+      zstd_in = ZSTD_inBuffer{zstd_input.data(), 0, 0};
+#else
+      std::cerr << "CorpusReader: " << filename << " is zstd-compressed, but w2vxx was built without zstd (make ZSTD=1)" << std::endl;
+      return false;
+#endif
+    }
+    pos = len = 0;
+    buffer_offset = (format == cffPlain) ? offset : 0;
+    eof_flag = false;
+    return true;
+  } // method-end
+  // закрытие файла (после закрытия признак конца файла установлен)
+  void close()
+  {
+    if (plain != nullptr)
+      fclose(plain);
+    plain = nullptr;
+#ifdef W2V_WITH_ZLIB
+    if (gz != nullptr)
+      gzclose(gz);
+    gz = nullptr;
+#endif
+#ifdef W2V_WITH_ZSTD
+    if (zstd != nullptr)
+      ZSTD_freeDStream(zstd);
+    zstd = nullptr;
+#endif
+    pos = len = 0;
+    eof_flag = true;
+  }
+  // чтение очередного байта (аналог fgetc: EOF в конце файла, после чего eof() == true)
+  inline int get()
+  {
+    if (pos == len && !refill())
+    {
+      eof_flag = true;
+      return EOF;
+    }
+    return static_cast<unsigned char>(buffer[pos++]);
+  }
+  // возврат последнего прочитанного байта (допустим сразу после успешного get)
+  inline void unget()
+  {
+    --pos;
+  }
+  // блочный доступ к буферу (для токенизатора, см. tokenizer.h):
+  // количество непрочитанных байт буфера (пустой буфер пополняется; 0 -- конец файла, после чего eof() == true)
+  inline size_t available()
+  {
+    if (pos == len && !refill())
+    {
+      eof_flag = true;
+      return 0;
+    }
+    return len - pos;
+  }
+  // начало непрочитанной части буфера
+  inline const char* current() const
+  {
+    return buffer.data() + pos;
+  }
+  // пропуск n прочитанных байт (n не больше available())
+  inline void skip(size_t n)
+  {
+    pos += n;
+  }
+  // объем буферов чтения
+  size_t buffer_bytes() const
+  {
+    size_t bytes = buffer.capacity();
+#ifdef W2V_WITH_ZSTD
+    bytes += zstd_input.capacity();
+#endif
+    return bytes;
+  }
+  // аналог ftell: позиция очередного непрочитанного байта (для сжатых файлов -- в распакованных данных)
+  inline uint64_t tell() const
+  {
+    return buffer_offset + pos;
+  }
+  // аналог feof: достигнут ли конец файла
+  inline bool eof() const
+  {
+    return eof_flag;
+  }
+  // формирование списка файлов обучающего множества по значению параметра -train:
+  // имя файла; имя каталога (все файлы каталога в алфавитном порядке); @<файл> со списком имен (по одному в строке);
+  // список имен через запятую
+  static bool list_files(const std::string& spec, std::vector<std::string>& files)
+  {
+    files.clear();
+    if (!spec.empty() && spec[0] == '@')
+    {
+      std::ifstream ifs(spec.substr(1));
+      if (!ifs.good())
+      {
+        std::cerr << "Can't open train files list: " << spec.substr(1) << std::endl;
+        return false;
+      }
+      std::string line;
+      while (std::getline(ifs, line))
+      {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) files.push_back(line);
+      }
+    }
+    else if (list_directory(spec, files))
+      std::sort(files.begin(), files.end());
+    else if (file_exists(spec) || spec.find(',') == std::string::npos)
+      files.push_back(spec);
+    else
+    {
+      size_t begin = 0;
+      while (begin <= spec.size())
+      {
+        size_t end = spec.find(',', begin);
+        if (end == std::string::npos) end = spec.size();
+        if (end > begin) files.push_back(spec.substr(begin, end - begin));
+        begin = end + 1;
+      }
+    }
+    if (files.empty())
+    {
+      std::cerr << "No train files in: " << spec << std::endl;
+      return false;
+    }
+    return true;
+  } // method-end
+private:
+  static const size_t READ_BUFFER_SIZE = 1 << 20;
+  CorpusFileFormat format = cffPlain;
+  FILE *plain = nullptr;
+#ifdef W2V_WITH_ZLIB
+  gzFile gz = nullptr;
+#endif
+#ifdef W2V_WITH_ZSTD
+  ZSTD_DStream *zstd = nullptr;
+  std::vector<char> zstd_input;
+  ZSTD_inBuffer zstd_in;
+#endif
+  std::vector<char> buffer;
+  size_t pos = 0;
+  size_t len = 0;
+  uint64_t buffer_offset = 0;  // позиция начала буфера в файле (в распакованных данных)
+  bool eof_flag = true;
+
+  // существует ли файл (или каталог) с заданным именем
+  static bool file_exists(const std::string& path)
+  {
+#ifdef _WIN32
+    std::error_code ec;
+    return std::filesystem::exists(path, ec);
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+#endif
+  }
+  // если path -- каталог, добавление в files имен всех обычных файлов каталога (без обхода подкаталогов)
+  static bool list_directory(const std::string& path, std::vector<std::string>& files)
+  {
+#ifdef _WIN32
+    std::error_code ec;
+    if ( !std::filesystem::is_directory(path, ec) ) return false;
+    for (auto&& entry : std::filesystem::directory_iterator(path, ec))
+      if (entry.is_regular_file(ec))
+        files.push_back(entry.path().string());
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr) return false;
+    while (dirent *entry = readdir(dir))
+    {
+      const std::string filename = path + "/" + entry->d_name;
+      if (stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+        files.push_back(filename);
+    }
+    closedir(dir);
+#endif
+    return true;
+  } // method-end
+  // чтение (с распаковкой) очередной порции данных в буфер; false -- данные закончились
+  bool refill()
+  {
+    buffer_offset += len;
+    pos = len = 0;
+    if (format == cffPlain)
+    {
+      if (plain != nullptr)
+        len = fread(buffer.data(), 1, buffer.size(), plain);
+    }
+#ifdef W2V_WITH_ZLIB
+    else if (format == cffGzip)
+    {
+      if (gz != nullptr)
+      {
+        const int n = gzread(gz, buffer.data(), static_cast<unsigned>(buffer.size()));
+        if (n < 0)
+        {
+          int errnum = 0;
+          std::cerr << "CorpusReader: gzip error: " << gzerror(gz, &errnum) << std::endl;
+        }
+        len = (n > 0) ? n : 0;
+      }
+    }
+#endif
+#ifdef W2V_WITH_ZSTD
+    else if (format == cffZstd)
+    {
+      if (zstd != nullptr)
+      {
+        ZSTD_outBuffer out = {buffer.data(), buffer.size(), 0};
+        while (out.pos == 0)
+        {
+          if (zstd_in.pos == zstd_in.size)
+          {
+            zstd_in.size = fread(zstd_input.data(), 1, zstd_input.size(), plain);
+            zstd_in.pos = 0;
+            if (zstd_in.size == 0) break;
+          }
+          const size_t rc = ZSTD_decompressStream(zstd, &out, &zstd_in);
+          if (ZSTD_isError(rc))
+          {
+            std::cerr << "CorpusReader: zstd error: " << ZSTD_getErrorName(rc) << std::endl;
+            break;
+          }
+        }
+        len = out.pos;
+      }
+    }
+#endif
+    return len > 0;
+  } // method-end
+}; // class-decl-end
+
+
+#endif /* CORPUS_READER_H_ */
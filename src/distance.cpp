@@ -7,50 +7,7 @@
 #include <cmath>
 #include <algorithm>
 #include <map>
-
-bool loadModel(const std::string& model_filename, uint64_t& words, uint64_t& size, std::vector<std::string>& vocab, float*& embeddings)
-{
-  // открываем файл модели
-  std::ifstream ifs(model_filename.c_str(), std::ios::binary);
-  if ( !ifs.good() )
-  {
-    std::cerr << "Input file not found" << std::endl;
-    return false;
-  }
-  std::string buf;
-  // считыавем размер матрицы
-  ifs >> words;
-  ifs >> size;
-  std::getline(ifs,buf); // считываем конец строки
-  // выделяем память для эмбеддингов
-  embeddings = (float *) malloc( words * size * sizeof(float) );
-  if (embeddings == nullptr)
-  {
-    std::cerr << "Cannot allocate memory: " << (words * size * sizeof(float) / 1048576) << " MB" << std::endl;
-    std::cerr << "    Words: " << words << std::endl;
-    std::cerr << "    Embedding size: " << size << std::endl;
-    return false;
-  }
-  // загрузка словаря и векторов
-  for (uint64_t w = 0; w < words; ++w)
-  {
-    std::getline(ifs, buf, ' '); // читаем слово (до пробела)
-    vocab.push_back(buf);
-    float* eOffset = embeddings + w*size;
-    ifs.read( reinterpret_cast<char*>( eOffset ), sizeof(float)*size ); // читаем вектор
-    // нормируем вектор (все компоненты в диапазон [-1; +1]
-    float len = std::sqrt( std::inner_product(eOffset, eOffset+size, eOffset, 0.0) );
-    if (len == 0)
-    {
-      std::cerr << "Embedding normalization error: Division by zero" << std::endl;
-      free(embeddings);
-      return false;
-    }
-    std::transform(eOffset, eOffset+size, eOffset, [len](float a) -> float {return a/len;});
-    std::getline(ifs,buf); // считываем конец строки
-  }
-  return true;
-}
+#include "model_loader.h"
 
 
 int main(int argc, char **argv)
@@ -103,27 +60,9 @@ int main(int argc, char **argv)
       std::cout << "  out of dictionary word..." << std::endl;
       continue;
     }
-    float* wiOffset = embeddings + widx*size;
     std::cout << "                                       word | cosine similarity" << std::endl
               << "  -------------------------------------------------------------" << std::endl;
-    std::multimap<float, std::string> best;
-    for (size_t i = 0; i < words; ++i)
-    {
-      if (i == widx) continue;
-      float* iOffset = embeddings + i*size;
-      float dist = std::inner_product(iOffset, iOffset+size, wiOffset, 0.0);
-      if (best.size() < n)
-        best.insert( std::pair<float, std::string>(dist, vocab[i]) );
-      else
-      {
-        auto minIt = best.begin();
-        if (dist > minIt->first)
-        {
-          best.erase(minIt);
-          best.insert( std::pair<float, std::string>(dist, vocab[i]) );
-        }
-      }
-    }
+    auto best = findNearest(embeddings, words, size, vocab, widx, n);
     // выводим результат поиска
     for (auto it = best.crbegin(), itEnd = best.crend(); it != itEnd; ++it)
     {
@@ -0,0 +1,89 @@
+#ifndef HOT_ROWS_H_
+#define HOT_ROWS_H_
+
+#include <vector>
+#include <cstddef>
+#include "weights_precision.h"
+
+
+// Частные (для потока управления) копии "горячих" строк весовых матриц.
+// Строки самых частотных слов (а при hierarchical softmax -- узлов у вершины дерева Хаффмана) обновляются всеми потоками
+// практически непрерывно, и кэш-линии с ними постоянно мигрируют между ядрами. Поток читает и обновляет собственную копию
+// таких строк, а накопленное приращение периодически (каждые N обучающих примеров) прибавляет к общей матрице
+// и заново считывает её актуальное состояние. Остальные строки по-прежнему обновляются в общей матрице (Hogwild).
+// Горячие строки матрицы образуют непрерывный диапазон индексов, поэтому проверка сводится к одному сравнению.
+
+
+// копии горячих строк одной весовой матрицы
+class HotRowsReplica
+{
+public:
+  // задание диапазона горячих строк [row_begin; row_begin + rows) и выделение памяти под копии (rows == 0 -- копий нет)
+  void init(size_t row_begin, size_t rows, size_t dim, size_t element_size)
+  {
+    begin = row_begin;
+    count = rows;
+    layer1_size = dim;
+    const size_t floats = (rows * dim * element_size + sizeof(float) - 1) / sizeof(float);
+    local.assign(floats, 0);
+    base.assign(floats, 0);
+  }
+  // строка с индексом idx: частная копия для горячей строки, иначе -- строка общей матрицы
+  template <typename T>
+  inline T* row(T *matrix, size_t idx)
+  {
+    const size_t r = idx - begin;  // для idx < begin за счет беззнакового переполнения r >= count
+    if (r < count)
+      return reinterpret_cast<T*>(local.data()) + r * layer1_size;
+    return matrix + idx * layer1_size;
+  }
+  // перенос накопленных приращений в общую матрицу и обновление копий её текущим состоянием
+  template <typename T>
+  void sync(T *matrix)
+  {
+    T *loc = reinterpret_cast<T*>(local.data());
+    T *snapshot = reinterpret_cast<T*>(base.data());
+    T *shared = matrix + begin * layer1_size;
+    for (size_t e = 0, eEnd = count * layer1_size; e < eEnd; ++e)
+    {
+      const float delta = to_float(loc[e]) - to_float(snapshot[e]);
+      if (delta != 0)
+        store_stochastic(shared[e], to_float(shared[e]) + delta);
+      loc[e] = snapshot[e] = shared[e];
+    }
+  }
+  size_t size() const
+  {
+    return count;
+  }
+private:
+  size_t begin = 0;
+  size_t count = 0;
+  size_t layer1_size = 0;
+  std::vector<float> local;  // рабочие копии строк (элементы формата хранения весов)
+  std::vector<float> base;   // состояние общей матрицы на момент последней синхронизации
+}; // class-decl-end
+
+
+// горячие строки обеих весовых матриц для одного потока управления
+struct HotRows
+{
+  HotRowsReplica in;     // строки матрицы input -> hidden (syn0)
+  HotRowsReplica out;    // строки матрицы hidden -> output (syn1)
+  size_t flush_interval = 0;
+  size_t examples_since_sync = 0;
+  bool enabled() const
+  {
+    return in.size() + out.size() > 0;
+  }
+  // учет очередного обучающего примера; true, если пора синхронизироваться с общими матрицами
+  inline bool tick()
+  {
+    if (++examples_since_sync < flush_interval) return false;
+    examples_since_sync = 0;
+    return enabled();
+  }
+};
+
+
+#endif /* HOT_ROWS_H_ */
@@ -0,0 +1,144 @@
+#ifndef IN_MEMORY_LE_PROVIDER_H_
+#define IN_MEMORY_LE_PROVIDER_H_
+
+#include <vector>
+#include <optional>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include "learning_example_provider.h"
+#include "profiler.h"
+#include "vocabulary.h"
+#include "subsampling.h"
+#include "original_word2vec_le_provider.h"
+
+
+// Поставщик обучающих примеров из корпуса, уже находящегося в памяти (для использования w2vxx как библиотеки).
+// Корпус задается вызывающей стороной как последовательность индексов слов в словаре; индекс 0 (</s>) -- конец предложения.
+// Буфер не копируется и должен существовать до окончания обучения. Как и в оригинальном word2vec, корпус делится между
+// потоками на равные части, предложения длиннее MAX_SENTENCE_LENGTH разбиваются, частотные слова прореживаются.
+class InMemoryLearningExampleProvider : public CustomLearningExampleProvider
+{
+public:
+  // конструктор
+  InMemoryLearningExampleProvider(const word_index_t *corpus_ids, size_t corpus_size, size_t threadsCount, size_t ctxWindow, float sampleThreshold,
+                                  std::shared_ptr< CustomVocabulary> words_vocabulary)
+  : CustomLearningExampleProvider(threadsCount)
+  , corpus(corpus_ids)
+  , corpus_length(corpus_size)
+  , window(ctxWindow)
+  , vocabulary(words_vocabulary)
+  {
+    thread_environment.resize(threads_count);
+    for (size_t i = 0; i < threads_count; ++i)
+      thread_environment[i].next_random = i;
+    subsampling.build(*vocabulary, sampleThreshold, vocabulary->cn_sum());
+  } // constructor-end
+  // деструктор
+  virtual ~InMemoryLearningExampleProvider()
+  {
+  }
+  // перевод последовательности токенов в индексы словаря ("</s>" -- конец предложения); несловарные токены пропускаются
+  template <typename TokenIterator>
+  static std::vector<word_index_t> encode(const CustomVocabulary& vocabulary, TokenIterator first, TokenIterator last)
+  {
+    std::vector<word_index_t> ids;
+    for (; first != last; ++first)
+    {
+      const word_index_t idx = vocabulary.word_to_idx(*first);
+      if (idx != NO_WORD_INDEX)
+        ids.push_back(idx);
+    }
+    return ids;
+  }
+  // подготовительные действия, выполняемые перед каждой эпохой обучения
+  bool epoch_prepare(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    t_environment.position = corpus_length * threadIndex / threads_count;
+    t_environment.end = corpus_length * (threadIndex + 1) / threads_count;
+    t_environment.sentence.clear();
+    t_environment.position_in_sentence = 0;
+    t_environment.words_count = 0;
+    return true;
+  }
+  // заключительные действия, выполняемые после каждой эпохи обучения
+  bool epoch_unprepare(size_t)
+  {
+    return true;
+  }
+  // получение очередного обучающего примера
+  std::optional<LearningExample> get(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    if (t_environment.sentence.empty())
+      read_sentence(t_environment);
+    if (t_environment.sentence.empty())  // это признак конца эпохи
+      return std::nullopt;
+    LearningExample result = make_window_example(t_environment.sentence, t_environment.position_in_sentence, window, t_environment.next_random);
+    ++t_environment.position_in_sentence;
+    if ( t_environment.position_in_sentence == static_cast<int>(t_environment.sentence.size()) )
+      t_environment.sentence.clear();
+    return result;
+  } // method-end
+  // получение количества слов, фактически считанных из обучающего множества (т.е. без учета сабсэмплинга)
+  uint64_t getWordsCount(size_t threadIndex) const
+  {
+    return thread_environment[threadIndex].words_count;
+  }
+private:
+  // информация, описывающая рабочий контекст одного потока управления (thread)
+  struct ThreadEnvironment
+  {
+    size_t position = 0;                 // текущая позиция в корпусе
+    size_t end = 0;                      // конец части корпуса данного потока
+    std::vector<word_index_t> sentence;  // последнее считанное предложение
+    int position_in_sentence = 0;        // текущая позиция в предложении
+    unsigned long long next_random = 0;  // поле для вычисления случайных величин
+    uint64_t words_count = 0;            // количество прочитанных слов
+  };
+  std::vector<ThreadEnvironment> thread_environment;
+  // корпус (индексы слов) и его длина
+  const word_index_t *corpus;
+  size_t corpus_length;
+  // максимальный размер контекстного окна
+  size_t window;
+  // словарь
+  std::shared_ptr< CustomVocabulary> vocabulary;
+  // пороги прореживания для каждого слова словаря
+  SubsamplingTable subsampling;
+
+  // чтение одного предложения
+  void read_sentence(ThreadEnvironment& t_environment)
+  {
+    t_environment.sentence.clear();
+    t_environment.position_in_sentence = 0;
+    while (t_environment.position < t_environment.end)
+    {
+      const word_index_t wordIdx = corpus[t_environment.position++];
+      if (wordIdx >= vocabulary->size()) continue;  // индекс вне словаря
+      ++t_environment.words_count;
+      profile_count(pcWordsRead);
+      if ( wordIdx == 0 )   // маркер конца предложения
+      {
+        if ( t_environment.sentence.empty() ) continue;
+        else break;
+      }
+      // The subsampling randomly discards frequent words while keeping the ranking same
+      if ( subsampling.enabled() )
+      {
+        t_environment.next_random = t_environment.next_random * (unsigned long long)25214903917 + 11;
+        if ( subsampling.discard(wordIdx, t_environment.next_random) )
+        {
+          profile_count(pcWordsDiscarded);
+          continue;
+        }
+      }
+      t_environment.sentence.push_back( wordIdx );
+      if (t_environment.sentence.size() >= MAX_SENTENCE_LENGTH) break;
+    }
+  } // method-end
+}; // class-decl-end
+
+
+#endif /* IN_MEMORY_LE_PROVIDER_H_ */
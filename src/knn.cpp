@@ -0,0 +1,268 @@
+#include <string>
+#include <cstring>       // for std::strerror
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include "profiler.h"
+#include "knn_command_line_parameters.h"
+#include "model_loader.h"
+
+
+// сосед: индекс слова в модели и косинусная мера близости
+struct Neighbor
+{
+  float score;
+  uint32_t idx;
+};
+
+// компаратор для min-кучи (в вершине кучи находится наименее близкий из найденных соседей)
+inline bool neighbor_greater(const Neighbor& a, const Neighbor& b)
+{
+  return a.score > b.score;
+}
+
+
+// рабочий контекст одного потока управления (thread)
+struct KnnThreadEnvironment
+{
+  std::vector<float> scores;                    // плитка (tile) значений близости размером tile_queries x tile_cands
+  std::vector< std::vector<Neighbor> > heaps;   // k лучших соседей для каждого слова-запроса плитки
+};
+
+
+// Вычисление таблицы k ближайших соседей для всего словаря модели.
+// Матрица нормированных векторов умножается сама на себя поблочно (плитками): блок запросов x блок кандидатов.
+// Размеры блоков подбираются так, чтобы блок кандидатов помещался в кэш L2 и многократно переиспользовался для всех запросов блока.
+// Память, помимо самой матрицы, ограничена размером плиток и буферами результатов: threads * tile_queries * (tile_cands + k).
+class KnnTableBuilder
+{
+public:
+  KnnTableBuilder(const float* theEmbeddings, uint64_t theWords, uint64_t theSize, size_t neighbors, size_t tileQueries, size_t tileCands)
+  : embeddings(theEmbeddings)
+  , words(theWords)
+  , size(theSize)
+  , k(neighbors)
+  , tile_queries(tileQueries)
+  , tile_cands(tileCands)
+  {
+  }
+  // поиск соседей для блока запросов [q_begin; q_end)
+  void process_block(KnnThreadEnvironment& env, uint64_t q_begin, uint64_t q_end) const
+  {
+    const size_t qn = q_end - q_begin;
+    env.scores.resize(tile_queries * tile_cands);
+    env.heaps.resize(tile_queries);
+    for (size_t q = 0; q < qn; ++q)
+    {
+      env.heaps[q].clear();
+      env.heaps[q].reserve(k);
+    }
+    for (uint64_t c_begin = 0; c_begin < words; c_begin += tile_cands)
+    {
+      const uint64_t c_end = std::min<uint64_t>(c_begin + tile_cands, words);
+      const size_t cn = c_end - c_begin;
+      // вычисляем плитку значений близости (по 4 запроса за раз, чтобы вектор кандидата читался из кэша однократно)
+      size_t q = 0;
+      for ( ; q + 4 <= qn; q += 4)
+      {
+        const float* q0 = embeddings + (q_begin + q) * size;
+        for (size_t c = 0; c < cn; ++c)
+          dot_4x1(q0, embeddings + (c_begin + c) * size, &env.scores[q * tile_cands + c], tile_cands);
+      }
+      for ( ; q < qn; ++q)
+      {
+        const float* qv = embeddings + (q_begin + q) * size;
+        for (size_t c = 0; c < cn; ++c)
+          env.scores[q * tile_cands + c] = dot(qv, embeddings + (c_begin + c) * size);
+      }
+      // обновляем k лучших соседей для каждого запроса
+      for (q = 0; q < qn; ++q)
+      {
+        auto& heap = env.heaps[q];
+        const float* row = &env.scores[q * tile_cands];
+        for (size_t c = 0; c < cn; ++c)
+        {
+          if (c_begin + c == q_begin + q) continue; // само слово соседом не считается
+          if (heap.size() < k)
+          {
+            heap.push_back( {row[c], static_cast<uint32_t>(c_begin + c)} );
+            std::push_heap(heap.begin(), heap.end(), neighbor_greater);
+          }
+          else if (row[c] > heap.front().score)
+          {
+            std::pop_heap(heap.begin(), heap.end(), neighbor_greater);
+            heap.back() = {row[c], static_cast<uint32_t>(c_begin + c)};
+            std::push_heap(heap.begin(), heap.end(), neighbor_greater);
+          }
+        }
+      }
+    }
+    // упорядочиваем соседей по убыванию близости
+    for (size_t q = 0; q < qn; ++q)
+      std::sort_heap(env.heaps[q].begin(), env.heaps[q].end(), neighbor_greater);
+  } // method-end
+private:
+  const float* embeddings;
+  uint64_t words;
+  uint64_t size;
+  size_t k;
+  size_t tile_queries;
+  size_t tile_cands;
+
+  // скалярное произведение с 8 независимыми аккумуляторами (это позволяет компилятору векторизовать цикл без -ffast-math)
+  inline float dot(const float* a, const float* b) const
+  {
+    float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t i = 0;
+    for ( ; i + 8 <= size; i += 8)
+      for (size_t l = 0; l < 8; ++l)
+        acc[l] += a[i + l] * b[i + l];
+    float result = 0;
+    for ( ; i < size; ++i)
+      result += a[i] * b[i];
+    for (size_t l = 0; l < 8; ++l)
+      result += acc[l];
+    return result;
+  }
+  // скалярные произведения четырех последовательных (в матрице) векторов-запросов на один вектор-кандидат
+  inline void dot_4x1(const float* q0, const float* c, float* out, size_t out_stride) const
+  {
+    const float* q1 = q0 + size;
+    const float* q2 = q1 + size;
+    const float* q3 = q2 + size;
+    float acc0[8] = {0}, acc1[8] = {0}, acc2[8] = {0}, acc3[8] = {0};
+    size_t i = 0;
+    for ( ; i + 8 <= size; i += 8)
+      for (size_t l = 0; l < 8; ++l)
+      {
+        const float cv = c[i + l];
+        acc0[l] += q0[i + l] * cv;
+        acc1[l] += q1[i + l] * cv;
+        acc2[l] += q2[i + l] * cv;
+        acc3[l] += q3[i + l] * cv;
+      }
+    float r0 = 0, r1 = 0, r2 = 0, r3 = 0;
+    for ( ; i < size; ++i)
+    {
+      r0 += q0[i] * c[i];
+      r1 += q1[i] * c[i];
+      r2 += q2[i] * c[i];
+      r3 += q3[i] * c[i];
+    }
+    for (size_t l = 0; l < 8; ++l)
+    {
+      r0 += acc0[l];
+      r1 += acc1[l];
+      r2 += acc2[l];
+      r3 += acc3[l];
+    }
+    out[0] = r0;
+    out[out_stride] = r1;
+    out[2 * out_stride] = r2;
+    out[3 * out_stride] = r3;
+  }
+}; // class-decl-end
+
+
+int main(int argc, char **argv)
+{
+  // выполняем разбор параметров командной строки
+  KnnCommandLineParameters cmdLineParams;
+  cmdLineParams.parse(argc, argv);
+  cmdLineParams.dbg_cout();
+
+  if (!cmdLineParams.isDefined("-model") || !cmdLineParams.isDefined("-output"))
+    return 0;
+
+  SimpleProfiler global_profiler;
+
+  const std::string format = cmdLineParams.getAsString("-format");
+  if (format != "tsv" && format != "bin")
+  {
+    std::cerr << "Unknown output format: " << format << std::endl;
+    return -1;
+  }
+  const size_t k = std::max(cmdLineParams.getAsInt("-k"), 1);
+  const size_t tile_queries = std::max(cmdLineParams.getAsInt("-tile-queries"), 4);
+  const size_t tile_cands = std::max(cmdLineParams.getAsInt("-tile-cands"), 1);
+  const size_t threads_count = std::max(cmdLineParams.getAsInt("-threads"), 1);
+
+  // загружаем модель (вектора сразу нормируются, поэтому скалярное произведение совпадает с косинусной мерой)
+  std::vector<std::string> vocab;
+  float *embeddings = nullptr;
+  uint64_t words = 0, size = 0;
+  if ( !loadModel(cmdLineParams.getAsString("-model"), words, size, vocab, embeddings, std::max(cmdLineParams.getAsInt("-top-n"), 0)) )
+    return -1;
+  if (words < 2)
+  {
+    std::cerr << "Too few words in the model" << std::endl;
+    free(embeddings);
+    return -1;
+  }
+  const size_t neighbors_count = std::min<uint64_t>(k, words - 1);
+  std::cout << "Words: " << words << "  Embedding size: " << size << std::endl;
+  std::cout << "Working memory (besides the model): "
+            << (threads_count * tile_queries * (tile_cands * sizeof(float) + neighbors_count * sizeof(Neighbor)) / 1024) << " KB" << std::endl;
+
+  FILE *fo = fopen(cmdLineParams.getAsString("-output").c_str(), "wb");
+  if ( fo == nullptr )
+  {
+    std::cerr << "Output file open: error: " << std::strerror(errno) << std::endl;
+    free(embeddings);
+    return -1;
+  }
+  // бинарный формат: заголовок "<words> <k>", затем для каждого слова запись "<word> " + k пар (uint32 индекс соседа в модели, float близость) + "\n"
+  if (format == "bin")
+    fprintf(fo, "%lu %lu\n", words, neighbors_count);
+
+  KnnTableBuilder builder(embeddings, words, size, neighbors_count, tile_queries, tile_cands);
+  std::vector<KnnThreadEnvironment> thread_environment(threads_count);
+  // обрабатываем словарь порциями (по блоку запросов на поток), результаты порции сразу сбрасываем в файл
+  const uint64_t batch_size = threads_count * tile_queries;
+  for (uint64_t batch_begin = 0; batch_begin < words; batch_begin += batch_size)
+  {
+    std::vector<std::thread> threads_vec;
+    threads_vec.reserve(threads_count);
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+      const uint64_t q_begin = std::min<uint64_t>(batch_begin + t * tile_queries, words);
+      const uint64_t q_end = std::min<uint64_t>(q_begin + tile_queries, words);
+      threads_vec.emplace_back(&KnnTableBuilder::process_block, &builder, std::ref(thread_environment[t]), q_begin, q_end);
+    }
+    for (size_t t = 0; t < threads_count; ++t)
+      threads_vec[t].join();
+    // сохраняем результаты в порядке следования слов в модели
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+      const uint64_t q_begin = std::min<uint64_t>(batch_begin + t * tile_queries, words);
+      const uint64_t q_end = std::min<uint64_t>(q_begin + tile_queries, words);
+      for (uint64_t q = q_begin; q < q_end; ++q)
+      {
+        auto&& heap = thread_environment[t].heaps[q - q_begin];
+        if (format == "tsv")
+        {
+          fprintf(fo, "%s", vocab[q].c_str());
+          for (auto&& n : heap)
+            fprintf(fo, "\t%s\t%f", vocab[n.idx].c_str(), n.score);
+        }
+        else
+        {
+          fprintf(fo, "%s ", vocab[q].c_str());
+          for (auto&& n : heap)
+          {
+            fwrite(&n.idx, sizeof(uint32_t), 1, fo);
+            fwrite(&n.score, sizeof(float), 1, fo);
+          }
+        }
+        fprintf(fo, "\n");
+      }
+    }
+    std::cout << '\r' << std::min(batch_begin + batch_size, words) << " / " << words << "     ";
+    std::cout.flush();
+  }
+  std::cout << std::endl;
+  fclose(fo);
+  free(embeddings);
+  return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef KNN_COMMAND_LINE_PARAMETERS_H_
+#define KNN_COMMAND_LINE_PARAMETERS_H_
+
+#include "command_line_parameters.h"
+
+class KnnCommandLineParameters : public CommandLineParameters
+{
+public:
+  KnnCommandLineParameters()
+  {
+    // initialize params mapping with std::initialzer_list<T>
+    params_ = {
+        {"-model",        {"Read word vectors (in the binary format) from <file>", std::nullopt, std::nullopt}},
+        {"-output",       {"Use <file> to save the nearest neighbors table", std::nullopt, std::nullopt}},
+        {"-format",       {"Output format: tab-separated text (tsv) or binary (bin)", "tsv", std::nullopt}},
+        {"-k",            {"Number of nearest neighbors for every word", "10", std::nullopt}},
+        {"-top-n",        {"Use only <int> most frequent words of the model (0 means the whole vocabulary)", "0", std::nullopt}},
+        {"-tile-queries", {"Number of query vectors in one tile", "256", std::nullopt}},
+        {"-tile-cands",   {"Number of candidate vectors in one tile", "512", std::nullopt}},
+        {"-threads",      {"Use <int> threads", "12", std::nullopt}}
+    };
+  }
+};
+
+#endif /* KNN_COMMAND_LINE_PARAMETERS_H_ */
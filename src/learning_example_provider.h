@@ -4,13 +4,14 @@
 #include <vector>
 #include <optional>
 #include <cstring>       // for std::strerror
+#include "vocabulary.h"
 
 
 // структура, представляющая обучающий пример
 struct LearningExample
 {
-  size_t word;                     // индекс слова (в словаре слов)
-  std::vector<size_t> context;     // индексы контекстов (в словаре контекстов) -- в оригинальном word2vec "словарь контекстов" == "словарь слов"
+  word_index_t word;                     // индекс слова (в словаре слов)
+  std::vector<word_index_t> context;     // индексы контекстов (в словаре контекстов) -- в оригинальном word2vec "словарь контекстов" == "словарь слов"
 };
 
 
@@ -37,6 +38,11 @@ public:
   virtual std::optional<LearningExample> get(size_t threadIndex) = 0;
   // получение количества слов, фактически считанных из обучающего множества (т.е. без учета сабсэмплинга)
   virtual uint64_t getWordsCount(size_t threadIndex) const = 0;
+  // объем памяти, занимаемой поставщиком (буферы чтения всех потоков управления и вспомогательные таблицы)
+  virtual uint64_t memory_bytes() const
+  {
+    return 0;
+  }
 protected:
   // количество потоков управления (thread), параллельно работающих с поставщиком обучающих примеров
   size_t threads_count;
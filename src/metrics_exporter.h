@@ -0,0 +1,257 @@
+#ifndef METRICS_EXPORTER_H_
+#define METRICS_EXPORTER_H_
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "trainer.h"
+
+#ifndef _WIN32
+  #include <unistd.h>
+  #include <poll.h>
+  #include <sys/types.h>
+  #include <sys/time.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <arpa/inet.h>
+#endif
+
+
+// Экспорт метрик обучения в текстовом формате Prometheus (text exposition format 0.0.4).
+// Отдельный поток управления раз в interval секунд снимает состояние обучения (CustomTrainer::status) и формирует текст метрик:
+// скорость (слов в секунду) и количество пройденных слов каждого потока, alpha, прогресс и эпоху, глубину очереди обучающих
+// примеров, прочитанных заранее, объем резидентной памяти процесса, оценку оставшегося времени и (при -loss-sample) функцию потерь.
+// Текст отдается по HTTP на 127.0.0.1:<port> (только локально: метрики забирает агент сбора на той же машине) и/или периодически
+// записывается в файл (атомарно -- через временный файл и переименование, как того требует textfile collector у node_exporter).
+// Потоки обучения лишь обновляют атомарные счетчики при выводе прогресс-сообщений, так что экспорт не влияет на результат обучения.
+
+
+class MetricsExporter
+{
+public:
+  // конструктор; interval_seconds -- периодичность снятия метрик
+  MetricsExporter(const CustomTrainer& observed_trainer, double interval_seconds)
+  : trainer(observed_trainer)
+  , interval( std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(interval_seconds, 0.1))) )
+  {
+  }
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+  ~MetricsExporter()
+  {
+    stop();
+#ifndef _WIN32
+    if (listen_fd >= 0) close(listen_fd);
+#endif
+  }
+  // открытие порта для отдачи метрик по HTTP (только на интерфейсе 127.0.0.1; до вызова start)
+  bool listen_on(uint16_t port)
+  {
+#ifndef _WIN32
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) { std::cerr << "Can't create socket" << std::endl; return false; }
+    int flag = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 8) != 0)
+    {
+      std::cerr << "Can't listen on port " << port << ": " << std::strerror(errno) << std::endl;
+      close(listen_fd);
+      listen_fd = -1;
+      return false;
+    }
+    std::cout << "Metrics are served at http://127.0.0.1:" << port << "/metrics" << std::endl;
+    return true;
+#else
+    std::cerr << "Metrics export over HTTP is not supported on this platform" << std::endl;
+    return false;
+#endif
+  } // method-end
+  // задание файла, в который периодически записываются метрики (до вызова start)
+  void write_to(const std::string& filename)
+  {
+    metrics_filename = filename;
+  }
+  // запуск потока экспорта (после init_net)
+  void start()
+  {
+    stopping = false;
+    worker = std::thread(&MetricsExporter::run, this);
+  }
+  // останов потока экспорта; в файл записываются метрики на момент останова
+  void stop()
+  {
+    if (!worker.joinable()) return;
+    stopping = true;
+    worker.join();
+  }
+private:
+  // максимальное время ожидания подключения, после которого проверяется признак останова
+  static constexpr int POLL_TIMEOUT_MS = 200;
+  const CustomTrainer& trainer;
+  std::chrono::steady_clock::duration interval;
+  std::string metrics_filename;
+  int listen_fd = -1;
+  std::thread worker;
+  std::atomic<bool> stopping{false};
+  // текст метрик, сформированный при последнем снятии
+  std::string exposition;
+  // предыдущее снятие (для расчета скорости потоков)
+  std::vector<uint64_t> last_words;
+  double last_seconds = 0;
+
+  // рабочий цикл потока экспорта
+  void run()
+  {
+    while (true)
+    {
+      const bool final_sample = stopping.load();
+      sample();
+      if (!metrics_filename.empty())
+        write_file();
+      if (final_sample) break;
+      const std::chrono::steady_clock::time_point next_sample_tp = std::chrono::steady_clock::now() + interval;
+      while ( !stopping.load() )
+      {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next_sample_tp - std::chrono::steady_clock::now()).count();
+        if (left <= 0) break;
+        const int timeout_ms = static_cast<int>( std::min<long long>(left, POLL_TIMEOUT_MS) );
+        if (listen_fd >= 0)
+          serve(timeout_ms);
+        else
+          std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+      }
+    }
+  } // method-end
+  // снятие состояния обучения и формирование текста метрик
+  void sample()
+  {
+    const CustomTrainer::Status status = trainer.status();
+    const size_t threads = status.thread_words.size();
+    const double dt = status.elapsed_seconds - last_seconds;
+    last_words.resize(threads, 0);
+    std::ostringstream out;
+    out.precision(10);
+    header(out, "w2vxx_words_total", "counter", "Words processed by the training thread (all epochs, before subsampling).");
+    for (size_t t = 0; t < threads; ++t)
+      out << "w2vxx_words_total{thread=\"" << t << "\"} " << status.thread_words[t] << "\n";
+    header(out, "w2vxx_words_per_second", "gauge", "Words per second of the training thread over the last sampling interval.");
+    for (size_t t = 0; t < threads; ++t)
+      out << "w2vxx_words_per_second{thread=\"" << t << "\"} " << ((dt > 0) ? (status.thread_words[t] - std::min(last_words[t], status.thread_words[t])) / dt : 0.0) << "\n";
+    header(out, "w2vxx_epoch", "gauge", "Current epoch of the training thread (starting from 1, 0 before training).");
+    for (size_t t = 0; t < threads; ++t)
+      out << "w2vxx_epoch{thread=\"" << t << "\"} " << status.thread_epoch[t] << "\n";
+    header(out, "w2vxx_provider_queue_depth", "gauge", "Learning examples read ahead by the training thread (see -prefetch).");
+    for (size_t t = 0; t < threads; ++t)
+      out << "w2vxx_provider_queue_depth{thread=\"" << t << "\"} " << status.thread_lookahead[t] << "\n";
+    header(out, "w2vxx_alpha", "gauge", "Current learning rate.");
+    out << "w2vxx_alpha " << status.alpha << "\n";
+    header(out, "w2vxx_progress", "gauge", "Share of the planned training completed (0..1).");
+    out << "w2vxx_progress " << status.progress << "\n";
+    header(out, "w2vxx_elapsed_seconds", "gauge", "Seconds since the start of training.");
+    out << "w2vxx_elapsed_seconds " << status.elapsed_seconds << "\n";
+    if (status.eta_seconds >= 0)
+    {
+      header(out, "w2vxx_eta_seconds", "gauge", "Estimated seconds until the end of training.");
+      out << "w2vxx_eta_seconds " << status.eta_seconds << "\n";
+    }
+    if (status.epoch_loss >= 0)
+    {
+      header(out, "w2vxx_epoch_loss", "gauge", "Mean sampled training loss over the last completed epoch (see -loss-sample).");
+      out << "w2vxx_epoch_loss " << status.epoch_loss << "\n";
+    }
+    uint64_t rss = 0;
+    if ( resident_bytes(rss) )
+    {
+      header(out, "w2vxx_resident_memory_bytes", "gauge", "Resident set size of the process.");
+      out << "w2vxx_resident_memory_bytes " << rss << "\n";
+    }
+    uint64_t major_faults = 0, minor_faults = 0;
+    if ( page_faults(major_faults, minor_faults) )
+    {
+      header(out, "w2vxx_page_faults_major_total", "counter", "Page faults of the process that required disk I/O.");
+      out << "w2vxx_page_faults_major_total " << major_faults << "\n";
+    }
+    last_words = status.thread_words;
+    last_seconds = status.elapsed_seconds;
+    exposition = out.str();
+  } // method-end
+  static void header(std::ostream& out, const char *name, const char *type, const char *help)
+  {
+    out << "# HELP " << name << " " << help << "\n" << "# TYPE " << name << " " << type << "\n";
+  }
+  // объем резидентной памяти процесса; false, если платформа не предоставляет таких сведений
+  static bool resident_bytes(uint64_t& bytes)
+  {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size_pages = 0, resident_pages = 0;
+    if ( !(statm >> size_pages >> resident_pages) ) return false;
+    bytes = resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return true;
+#else
+    return false;
+#endif
+  }
+  // атомарная запись метрик в файл: читатель видит либо прежнюю, либо новую версию целиком
+  void write_file()
+  {
+    const std::string tmp_filename = metrics_filename + ".tmp";
+    FILE *fo = fopen(tmp_filename.c_str(), "wb");
+    if (fo == nullptr)
+    {
+      std::cerr << "Can't write metrics file: " << tmp_filename << ": " << std::strerror(errno) << std::endl;
+      return;
+    }
+    const bool written = (fwrite(exposition.data(), 1, exposition.size(), fo) == exposition.size());
+    if (fclose(fo) != 0 || !written || std::rename(tmp_filename.c_str(), metrics_filename.c_str()) != 0)
+    {
+      std::cerr << "Can't write metrics file: " << metrics_filename << ": " << std::strerror(errno) << std::endl;
+      std::remove(tmp_filename.c_str());
+    }
+  } // method-end
+  // ожидание подключения не дольше timeout_ms и ответ на запрос (на любой путь отдается текст метрик)
+  void serve(int timeout_ms)
+  {
+#ifndef _WIN32
+    pollfd pfd = {listen_fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0 || !(pfd.revents & POLLIN)) return;
+    int client = accept(listen_fd, nullptr, nullptr);
+    if (client < 0) return;
+    // запрос читается лишь для того, чтобы клиент не получил сброс соединения; его содержимое не разбирается
+    timeval tv = {1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    char request[4096];
+    ::recv(client, request, sizeof(request), 0);
+    const std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(exposition.size()) +
+                                 "\r\nConnection: close\r\n\r\n" + exposition;
+    const char *p = response.data();
+    size_t bytes = response.size();
+    while (bytes > 0)
+    {
+      ssize_t sent = ::send(client, p, bytes, MSG_NOSIGNAL);
+      if (sent <= 0) break;
+      p += sent;
+      bytes -= sent;
+    }
+    close(client);
+#endif
+  } // method-end
+}; // class-decl-end
+
+
+#endif /* METRICS_EXPORTER_H_ */
@@ -0,0 +1,90 @@
+#ifndef MODEL_LOADER_H_
+#define MODEL_LOADER_H_
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <numeric>
+#include <cmath>
+#include <algorithm>
+#include <map>
+
+
+// загрузка векторной модели (в бинарном формате word2vec) с нормированием векторов
+// если max_words > 0, то загружаются только первые max_words слов (в словаре build_dict это самые частотные слова)
+inline bool loadModel(const std::string& model_filename, uint64_t& words, uint64_t& size, std::vector<std::string>& vocab, float*& embeddings, uint64_t max_words = 0)
+{
+  // открываем файл модели
+  std::ifstream ifs(model_filename.c_str(), std::ios::binary);
+  if ( !ifs.good() )
+  {
+    std::cerr << "Input file not found" << std::endl;
+    return false;
+  }
+  std::string buf;
+  // считыавем размер матрицы
+  ifs >> words;
+  ifs >> size;
+  std::getline(ifs,buf); // считываем конец строки
+  if (max_words > 0 && max_words < words)
+    words = max_words;
+  // выделяем память для эмбеддингов
+  embeddings = (float *) malloc( words * size * sizeof(float) );
+  if (embeddings == nullptr)
+  {
+    std::cerr << "Cannot allocate memory: " << (words * size * sizeof(float) / 1048576) << " MB" << std::endl;
+    std::cerr << "    Words: " << words << std::endl;
+    std::cerr << "    Embedding size: " << size << std::endl;
+    return false;
+  }
+  // загрузка словаря и векторов
+  vocab.reserve(words);
+  for (uint64_t w = 0; w < words; ++w)
+  {
+    std::getline(ifs, buf, ' '); // читаем слово (до пробела)
+    vocab.push_back(buf);
+    float* eOffset = embeddings + w*size;
+    ifs.read( reinterpret_cast<char*>( eOffset ), sizeof(float)*size ); // читаем вектор
+    // нормируем вектор (все компоненты в диапазон [-1; +1]
+    float len = std::sqrt( std::inner_product(eOffset, eOffset+size, eOffset, 0.0) );
+    if (len == 0)
+    {
+      std::cerr << "Embedding normalization error: Division by zero" << std::endl;
+      free(embeddings);
+      return false;
+    }
+    std::transform(eOffset, eOffset+size, eOffset, [len](float a) -> float {return a/len;});
+    std::getline(ifs,buf); // считываем конец строки
+  }
+  return true;
+}
+
+
+// поиск n ближайших (по косинусной мере) слов для слова с индексом widx
+inline std::multimap<float, std::string> findNearest(const float* embeddings, uint64_t words, uint64_t size, const std::vector<std::string>& vocab, size_t widx, size_t n)
+{
+  const float* wiOffset = embeddings + widx*size;
+  std::multimap<float, std::string> best;
+  for (size_t i = 0; i < words; ++i)
+  {
+    if (i == widx) continue;
+    const float* iOffset = embeddings + i*size;
+    float dist = std::inner_product(iOffset, iOffset+size, wiOffset, 0.0);
+    if (best.size() < n)
+      best.insert( std::pair<float, std::string>(dist, vocab[i]) );
+    else
+    {
+      auto minIt = best.begin();
+      if (dist > minIt->first)
+      {
+        best.erase(minIt);
+        best.insert( std::pair<float, std::string>(dist, vocab[i]) );
+      }
+    }
+  }
+  return best;
+}
+
+
+#endif /* MODEL_LOADER_H_ */
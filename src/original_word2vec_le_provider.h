@@ -6,25 +6,58 @@
 #include <optional>
 #include <memory>
 #include <limits>
+#include <algorithm>
+#include <numeric>
 #include <math.h>
 #include "learning_example_provider.h"
+#include "profiler.h"
 #include "original_word2vec_vocabulary.h"
+#include "subsampling.h"
+#include "corpus_reader.h"
+#include "tokenizer.h"
 
 
 const size_t MAX_SENTENCE_LENGTH = 1000;
-const size_t MAX_STRING = 100;
+
+
+// формирование обучающего примера для слова в позиции position предложения: контекст -- слова в окне, размер которого
+// выбирается случайно в диапазоне [1; window] (next_random -- генератор случайных чисел потока управления)
+// используется всеми поставщиками, формирующими обучающие примеры из предложений
+inline LearningExample make_window_example(const std::vector<word_index_t>& sentence, int position, size_t window, unsigned long long& next_random)
+{
+  LearningExample result;
+  result.word = sentence[position];
+  next_random = next_random * (unsigned long long)25214903917 + 11;
+  auto current_window = next_random % window;
+
+  // можно сделать так:
+  // ++current_window;  // current_window попадает в диапазон [1; window]
+  // но для удобства сопоставления результатов с оригинальным word2vec сделаем по аналогии с оригиналом
+  current_window = window - current_window;
+
+  for (int i = position - current_window, iEnd = position + current_window; i <= iEnd; ++i)
+  {
+    if ( i < 0 ) continue;
+    if ( i == position ) continue; // пропускаем само слово, для которого ищем контекст
+    if ( i >= static_cast<int>(sentence.size()) ) break;
+    result.context.emplace_back(sentence[i]);
+  }
+  return result;
+}
 
 
 // информация, описывающая рабочий контекст одного потока управления (thread)
 struct ThreadEnvironment_w2v
 {
-  FILE* fi;                              // хэндлер файла, содержащего обучающее множество (открывается с позиции, рассчитанной для данного потока управления).
-  std::vector<size_t> sentence;          // последнее считанное предложение
+  std::unique_ptr<CorpusReader> reader;  // чтение файла, содержащего обучающее множество (открывается с позиции, рассчитанной для данного потока управления).
+  size_t next_file;                      // номер следующего файла из списка файлов данного потока (при обучении по нескольким файлам)
+  std::vector<word_index_t> sentence;    // последнее считанное предложение
   int position_in_sentence;              // текущая позиция в предложении
   unsigned long long next_random;        // поле для вычисления случайных величин
   unsigned long long words_count;        // количество прочитанных словарных слов
   ThreadEnvironment_w2v()
-  : fi(nullptr)
+  : reader(std::make_unique<CorpusReader>())
+  , next_file(0)
   , position_in_sentence(-1)
   , next_random(0)
   , words_count(0)
@@ -55,33 +88,65 @@ public:
     for (size_t i = 0; i < threads_count; ++i)
       thread_environment[i].next_random = i;
     if ( vocabulary )
+    {
       train_words = vocabulary->cn_sum();
-    try
+      subsampling.build(*vocabulary, sample, train_words);
+    }
+    corpus_words = train_words;
+    // обучающее множество -- один файл, каталог или список файлов (см. CorpusReader::list_files)
+    CorpusReader::list_files(train_filename, train_files);
+    train_files_sizes.assign(train_files.size(), 0);
+    for (size_t f = 0; f < train_files.size(); ++f)
     {
-      train_file_size = get_file_size(train_filename);
-    } catch (const std::runtime_error& e) {
-      std::cerr << "LearningExampleProvider can't get file size for: " << train_filename << "\n  " << e.what() << std::endl;
+      try
+      {
+        train_files_sizes[f] = get_file_size(train_files[f]);
+      } catch (const std::runtime_error& e) {
+        std::cerr << "LearningExampleProvider can't get file size for: " << train_files[f] << "\n  " << e.what() << std::endl;
+      }
     }
+    // единственный несжатый файл, как и в оригинальном word2vec, делится между потоками по смещению;
+    // иначе потокам распределяются целые файлы
+    split_by_offset = (train_files.size() == 1 && CorpusReader::detect_format(train_files[0]) == cffPlain);
+    if (split_by_offset)
+      train_file_size = train_files_sizes[0];
+    assign_files();
   } // constructor-end
   // деструктор
   virtual ~OriginalWord2VecLearningExampleProvider()
   {
   }
+  // задание количества слов в обучающем множестве, если оно отличается от суммы частот словаря (например, при дообучении
+  // словарь включает и ранее изученные тексты); определяет границы частей обучающего множества, перебираемых потоками
+  void set_corpus_words(uint64_t words)
+  {
+    corpus_words = words;
+  }
+  // ограничение перебора частью обучающего множества с номером shard_idx из shards_count (при распределенном обучении);
+  // часть, в свою очередь, делится между потоками управления
+  void set_shard(size_t shard_idx, size_t shards_count)
+  {
+    shard = shard_idx;
+    shards = std::max<size_t>(shards_count, 1);
+    assign_files();
+  }
   // подготовительные действия, выполняемые перед каждой эпохой обучения
   bool epoch_prepare(size_t threadIndex)
   {
     auto& t_environment = thread_environment[threadIndex];
-    t_environment.fi = fopen(train_filename.c_str(), "rb");
-    if ( t_environment.fi == nullptr )
+    if (split_by_offset)
     {
-      std::cerr << "LearningExampleProvider: epoch prepare error: " << std::strerror(errno) << std::endl;
-      return false;
+      if ( !t_environment.reader->open(train_files[0], train_file_size / (threads_count * shards) * (shard * threads_count + threadIndex)) )
+      {
+        std::cerr << "LearningExampleProvider: epoch prepare error" << std::endl;
+        return false;
+      }
     }
-    int succ = fseek(t_environment.fi, train_file_size / threads_count * threadIndex, SEEK_SET);
-    if (succ != 0)
+    else
     {
-      std::cerr << "LearningExampleProvider: epoch prepare error: " << std::strerror(errno) << std::endl;
-      return false;
+      // потоку может не достаться ни одного файла (файлов меньше, чем потоков) -- тогда эпоха для него сразу заканчивается
+      t_environment.next_file = 0;
+      open_next_file(threadIndex);
     }
     t_environment.sentence.clear();
     t_environment.position_in_sentence = 0;
@@ -92,7 +157,7 @@ public:
   bool epoch_unprepare(size_t threadIndex)
   {
     auto& t_environment = thread_environment[threadIndex];
-    fclose( t_environment.fi );
+    t_environment.reader->close();
     return true;
   }
   // получение очередного обучающего примера
@@ -103,81 +168,69 @@ public:
       read_sentence(threadIndex);
     if (t_environment.sentence.empty())  // это признак конца эпохи
       return std::nullopt;
-    LearningExample result;
-    result.word = t_environment.sentence[t_environment.position_in_sentence];
-    t_environment.update_random();
-    auto current_window = t_environment.next_random % window;
-
-    // можно сделать так:
-    // ++current_window;  // current_window попадает в диапазон [1; window]
-    // но для удобства сопоставления результатов с оригинальным word2vec сделаем по аналогии с оригиналом
-    current_window = window - current_window;
-
-    for (int i = t_environment.position_in_sentence - current_window, iEnd = t_environment.position_in_sentence + current_window; i <= iEnd; ++i)
-    {
-      if ( i < 0 ) continue;
-      if ( i == t_environment.position_in_sentence ) continue; // пропускаем само слово, для которого ищем контекст
-      if ( i >= static_cast<int>(t_environment.sentence.size()) ) break;
-      result.context.emplace_back(t_environment.sentence[i]);
-    }
+    LearningExample result = make_window_example(t_environment.sentence, t_environment.position_in_sentence, window, t_environment.next_random);
     ++t_environment.position_in_sentence;
     if ( t_environment.position_in_sentence == static_cast<int>(t_environment.sentence.size()) )
       t_environment.sentence.clear();
     return result;
   } // method-end
+  // получение очередного предложения (после прореживания) без формирования обучающих примеров;
+  // используется, когда одно чтение обучающего множества разделяют несколько моделей (см. shared_sentence_stream.h)
+  // false -- признак конца эпохи
+  bool get_sentence(size_t threadIndex, std::vector<word_index_t>& sentence)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    read_sentence(threadIndex);
+    sentence.swap(t_environment.sentence);
+    t_environment.sentence.clear();
+    t_environment.position_in_sentence = 0;
+    return !sentence.empty();
+  }
   // получение количества слов, фактически считанных из обучающего множества (т.е. без учета сабсэмплинга)
   uint64_t getWordsCount(size_t threadIndex) const
   {
     return thread_environment[threadIndex].words_count;
   }
+  // объем памяти, занимаемой поставщиком: буферы чтения и предложений всех потоков управления, таблица прореживания
+  uint64_t memory_bytes() const
+  {
+    uint64_t bytes = heap_block_bytes(thread_environment.capacity() * sizeof(ThreadEnvironment_w2v)) + subsampling.memory_bytes();
+    for (auto&& t_environment : thread_environment)
+    {
+      bytes += heap_block_bytes(sizeof(CorpusReader)) + heap_block_bytes(t_environment.reader->buffer_bytes());
+      bytes += heap_block_bytes(t_environment.sentence.capacity() * sizeof(word_index_t));
+    }
+    return bytes;
+  }
 private:
   // информация, описывающая рабочие контексты потоков управления (thread)
   std::vector<ThreadEnvironment_w2v> thread_environment;
-  // имя "тренировочного" файла
+  // имя "тренировочного" файла (каталога, списка файлов)
   std::string train_filename;
-  // размер тренировочного файла
+  // файлы обучающего множества и их размеры
+  std::vector<std::string> train_files;
+  std::vector<uint64_t> train_files_sizes;
+  // делится ли единственный файл между потоками по смещению (иначе каждому потоку назначается список целых файлов)
+  bool split_by_offset = false;
+  // номера файлов, назначенных каждому потоку
+  std::vector< std::vector<size_t> > thread_files;
+  // размер тренировочного файла (при делении по смещению)
   uint64_t train_file_size;
   // максимальный размер контекстного окна
   size_t window;
   // порог для алгоритма сэмплирования (subsampling)
   float sample;
+  // пороги прореживания для каждого слова словаря
+  SubsamplingTable subsampling;
   // словарь
   std::shared_ptr< OriginalWord2VecVocabulary> vocabulary;
   // количество слов в обучающем множестве (приблизительно, т.к. могло быть подрезание по порогу частоты при построении словаря)
   uint64_t train_words;
-
-  // чтение одного слова из файла в предположении, что разделителями служат space + tab + EOL
-  void read_word(FILE *fin, std::string& word)
-  {
-    word.clear();
-    size_t a = 0;
-    while ( !feof(fin) )
-    {
-      int ch = fgetc(fin);
-      if (ch == 13) continue;   //  \r
-      if ((ch == ' ') || (ch == '\t') || (ch == '\n'))
-      {
-        // если есть прочитанный фрагмент слова
-        if (a > 0)
-        {
-          if (ch == '\n')
-            ungetc(ch, fin);
-          break;
-        }
-        // если прочитанного фрагмента слова нет
-        if (ch == '\n')
-        {
-          word = "</s>";
-          return;
-        }
-        else
-          continue;
-      } // if (delimiter) ...
-      if ( a < MAX_STRING )
-        word.push_back( ch );
-      ++a;
-    }
-  } // method-end
+  // количество слов в обучающем множестве
+  uint64_t corpus_words;
+  // часть обучающего множества, перебираемая данным процессом, и количество частей
+  size_t shard = 0;
+  size_t shards = 1;
 
   // чтение одного предложения
   void read_sentence(size_t threadIndex)
@@ -189,34 +242,81 @@ private:
     word.reserve(MAX_STRING);
     while (true)
     {
-      read_word(t_environment.fi, word);
-      if ( feof(t_environment.fi) ) break;
+      read_word(*t_environment.reader, word);
+      if ( t_environment.reader->eof() )
+      {
+        // при обучении по нескольким файлам переходим к следующему файлу потока
+        if ( open_next_file(threadIndex) ) continue;
+        break;
+      }
       auto wordIdx = vocabulary->word_to_idx(word);
-      if (wordIdx == std::numeric_limits<size_t>::max()) continue;  // несловарное слово
+      if (wordIdx == NO_WORD_INDEX) continue;  // несловарное слово
       ++t_environment.words_count;
+      profile_count(pcWordsRead);
       if ( wordIdx == 0 )   // маркер конца параграфа (предложения)
       {
         if ( t_environment.sentence.empty() ) continue; //  пустые предложения игнорируем (т.к. пустое предложение -- это ещё и признак окончания эпохи)
         else break;
       }
       // The subsampling randomly discards frequent words while keeping the ranking same
-      if (sample > 0)
+      if ( subsampling.enabled() )
       {
-        auto&& dict_word = vocabulary->idx_to_data(wordIdx);
-        float ran = (sqrt(dict_word.cn / (sample * train_words)) + 1) * (sample * train_words) / dict_word.cn;
+        profile_section(psInputSubsampling);
         t_environment.update_random();
-        if (ran < (t_environment.next_random & 0xFFFF) / (float)65536) continue;
+        bool discard = subsampling.discard(wordIdx, t_environment.next_random);
+        profile_section(psInputTokenize);
+        if (discard)
+        {
+          profile_count(pcWordsDiscarded);
+          continue;
+        }
       }
       t_environment.sentence.push_back( wordIdx );
       if (t_environment.sentence.size() >= MAX_SENTENCE_LENGTH) break;
     }
     // не настал ли конец эпохи?
-    if ( feof(t_environment.fi) || (t_environment.words_count > train_words / threads_count) )
+    if ( t_environment.reader->eof() || (split_by_offset && t_environment.words_count > corpus_words / (threads_count * shards)) )
     {
       t_environment.sentence.clear();
       t_environment.position_in_sentence = 0;
     }
   } // method-end
+
+  // распределение целых файлов между потоками (всех процессов распределенного обучения): файлы в порядке убывания размера
+  // назначаются наименее загруженному (в байтах) потоку; распределение детерминировано
+  void assign_files()
+  {
+    thread_files.assign(threads_count, {});
+    if (split_by_offset) return;
+    std::vector<size_t> order(train_files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return train_files_sizes[a] > train_files_sizes[b]; });
+    std::vector<uint64_t> load(threads_count * shards, 0);
+    for (auto&& f : order)
+    {
+      const size_t slot = std::min_element(load.begin(), load.end()) - load.begin();
+      load[slot] += std::max<uint64_t>(train_files_sizes[f], 1);
+      if (slot / threads_count == shard)
+        thread_files[slot % threads_count].push_back(f);
+    }
+    for (auto&& files : thread_files)
+      std::sort(files.begin(), files.end());
+  } // method-end
+
+  // открытие следующего файла из списка файлов потока; false -- файлы потока закончились (или обучающее множество -- один файл)
+  bool open_next_file(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    t_environment.reader->close();
+    if (split_by_offset) return false;
+    auto&& files = thread_files[threadIndex];
+    while (t_environment.next_file < files.size())
+    {
+      if ( t_environment.reader->open(train_files[files[t_environment.next_file++]]) )
+        return true;
+    }
+    return false;
+  } // method-end
 };
 
 
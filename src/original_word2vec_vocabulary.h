@@ -8,6 +8,7 @@
 #include <iostream>
 #include <regex>
 #include <limits>
+#include <algorithm>
 #include "vocabulary.h"
 
 class OriginalWord2VecVocabulary : public CustomVocabulary
@@ -53,20 +54,69 @@ public:
       vocabulary_hash[vocabulary_record_components[0]] = vocabulary.size(); // сразу строим хэш-отображение для поиска индекса слова в словаре по слову (строке)
       vocabulary.emplace_back( vocabulary_record_components[0], std::stoull(vocabulary_record_components[1]) );
     }
-    return true;
+    return check_index_range(filename);
+  }
+  // построение словаря в памяти по последовательности токенов (аналогично утилите build_dict): "</s>" -- маркер конца предложения,
+  // слова с частотой ниже min_count отбрасываются, словарь упорядочивается по убыванию частоты (</s> остается первым)
+  // false -- словарь не умещается в индексы word_index_t
+  template <typename TokenIterator>
+  bool build(TokenIterator first, TokenIterator last, uint64_t min_count)
+  {
+    vocabulary.clear();
+    vocabulary_hash.clear();
+    merge("</s>", 0);
+    for (; first != last; ++first)
+      merge(*first, 1);
+    vocabulary.erase( std::remove_if(vocabulary.begin() + 1, vocabulary.end(), [min_count](const VocabularyData& data) { return data.cn < min_count; }),
+                      vocabulary.end() );
+    vocabulary_hash.clear();
+    sort_by_frequency();
+    return check_index_range("in-memory corpus");
+  }
+  // добавление частоты слова (новое слово дописывается в конец словаря);
+  // после серии добавлений словарь следует упорядочить вызовом sort_by_frequency
+  void merge(const std::string& word, uint64_t cn)
+  {
+    auto it = vocabulary_hash.find(word);
+    if (it != vocabulary_hash.end())
+      vocabulary[it->second].cn += cn;
+    else
+    {
+      vocabulary_hash[word] = vocabulary.size();
+      vocabulary.emplace_back(word, cn);
+    }
+  }
+  // упорядочение словаря по убыванию частоты (маркер конца предложения </s> остается первым)
+  void sort_by_frequency()
+  {
+    auto first = vocabulary.begin();
+    if (first != vocabulary.end() && first->word == "</s>")
+      ++first;
+    std::stable_sort(first, vocabulary.end(), [](const VocabularyData& a, const VocabularyData& b) { return a.cn > b.cn; });
+    for (size_t idx = 0; idx < vocabulary.size(); ++idx)
+      vocabulary_hash[vocabulary[idx].word] = idx;
   }
   // получение индекса в словаре по тексту слова
-  size_t word_to_idx(const std::string& word) const
+  word_index_t word_to_idx(const std::string& word) const
   {
     auto it = vocabulary_hash.find(word);
     if (it == vocabulary_hash.end())
-      return std::numeric_limits<size_t>::max();
+      return NO_WORD_INDEX;
     else
       return it->second;
   }
+  // объем памяти, занимаемой словарем, включая хэш-отображение: массив корзин и по узлу на слово
+  // (указатель на следующий узел, пара слово-индекс и хэш-код слова)
+  uint64_t memory_bytes() const
+  {
+    uint64_t bytes = CustomVocabulary::memory_bytes() + heap_block_bytes(vocabulary_hash.bucket_count() * sizeof(void*));
+    for (auto&& record : vocabulary_hash)
+      bytes += heap_block_bytes(sizeof(void*) + sizeof(record) + sizeof(size_t)) + string_heap_bytes(record.first.capacity());
+    return bytes;
+  }
 private:
   // хэш-отображение слов в их индексы в словаре (для быстрого поиска)
-  std::unordered_map<std::string, size_t> vocabulary_hash;
+  std::unordered_map<std::string, word_index_t> vocabulary_hash;
 };
 
 #endif /* ORIGINAL_WORD2VEC_VOCABULARY_H_ */
@@ -0,0 +1,239 @@
+#ifndef PAIRS_FILE_LE_PROVIDER_H_
+#define PAIRS_FILE_LE_PROVIDER_H_
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "learning_example_provider.h"
+#include "profiler.h"
+#include "vocabulary.h"
+#include "subsampling.h"
+
+
+// Бинарный файл пар (слово, контекст).
+// Позволяет обучаться на произвольных контекстах (синтаксических, позиционных и т.п.), заданных отдельным словарем контекстов.
+// Пары заранее переведены в индексы словарей (утилитой build_pairs), поэтому при обучении не требуется ни разбор текста,
+// ни поиск слов в словаре. Формат (little-endian):
+//   заголовок  -- PairsFileHeader (сигнатура, размеры словарей слов и контекстов, количество пар);
+//   тело       -- пары (uint32 индекс слова в словаре слов, uint32 индекс контекста в словаре контекстов).
+// Идущие подряд пары с одним и тем же словом (контексты одного вхождения слова) образуют один обучающий пример.
+const char PAIRS_FILE_MAGIC[8] = {'W', '2', 'V', 'X', 'P', 'R', 'S', '1'};
+
+struct PairsFileHeader
+{
+  char magic[8];
+  uint64_t words_vocab_size;
+  uint64_t contexts_vocab_size;
+  uint64_t pairs_count;
+};
+
+// количество пар, считываемых из файла за одно обращение
+const size_t PAIRS_READ_BUFFER = 65536;
+
+
+// информация, описывающая рабочий контекст одного потока управления (thread)
+struct ThreadEnvironment_pairs
+{
+  FILE* fi;                              // хэндлер файла пар (открывается с позиции, рассчитанной для данного потока управления)
+  std::vector<uint32_t> buffer;          // считанные, но ещё не обработанные пары (слово и контекст поочередно)
+  size_t buffer_pos;                     // текущая позиция в буфере (в парах)
+  size_t buffer_len;                     // количество пар в буфере
+  uint64_t pairs_left;                   // количество пар части файла данного потока, ещё не считанных в буфер
+  unsigned long long next_random;        // поле для вычисления случайных величин
+  unsigned long long pairs_read;         // количество обработанных пар
+  ThreadEnvironment_pairs()
+  : fi(nullptr)
+  , buffer_pos(0)
+  , buffer_len(0)
+  , pairs_left(0)
+  , next_random(0)
+  , pairs_read(0)
+  {
+  }
+  inline void update_random()
+  {
+    next_random = next_random * (unsigned long long)25214903917 + 11;
+  }
+};
+
+
+class PairsFileLearningExampleProvider : public CustomLearningExampleProvider
+{
+public:
+  // конструктор
+  PairsFileLearningExampleProvider(const std::string& pairsFilename, size_t threadsCount, float sampleThreshold,
+                                   std::shared_ptr< CustomVocabulary> words_vocabulary,
+                                   std::shared_ptr< CustomVocabulary> contexts_vocabulary)
+  : CustomLearningExampleProvider(threadsCount)
+  , pairs_filename(pairsFilename)
+  , words_vocab_size(words_vocabulary->size())
+  , contexts_vocab_size(contexts_vocabulary->size())
+  {
+    thread_environment.resize(threads_count);
+    for (size_t i = 0; i < threads_count; ++i)
+      thread_environment[i].next_random = i;
+    // прореживаются (как и в оригинальном word2vec) частотные слова; контексты не прореживаются
+    subsampling.build(*words_vocabulary, sampleThreshold, words_vocabulary->cn_sum());
+    FILE *fi = fopen(pairs_filename.c_str(), "rb");
+    if ( fi == nullptr )
+    {
+      std::cerr << "PairsFileLearningExampleProvider: can't open " << pairs_filename << ": " << std::strerror(errno) << std::endl;
+      return;
+    }
+    PairsFileHeader header;
+    const bool header_read = (fread(&header, sizeof(header), 1, fi) == 1);
+    fclose(fi);
+    if ( !header_read || memcmp(header.magic, PAIRS_FILE_MAGIC, sizeof(header.magic)) != 0 )
+      std::cerr << "PairsFileLearningExampleProvider: not a pairs file (see build_pairs): " << pairs_filename << std::endl;
+    else if ( header.words_vocab_size != words_vocab_size || header.contexts_vocab_size != contexts_vocab_size )
+      std::cerr << "PairsFileLearningExampleProvider: pairs file was built for other vocabularies ("
+                << header.words_vocab_size << " words, " << header.contexts_vocab_size << " contexts): " << pairs_filename << std::endl;
+    else
+    {
+      pairs_count = header.pairs_count;
+      valid = true;
+    }
+  } // constructor-end
+  // деструктор
+  virtual ~PairsFileLearningExampleProvider()
+  {
+  }
+  // удалось ли открыть файл пар и соответствует ли он словарям
+  bool is_valid() const
+  {
+    return valid;
+  }
+  // количество пар в файле
+  uint64_t get_pairs_count() const
+  {
+    return pairs_count;
+  }
+  // ограничение перебора частью файла с номером shard_idx из shards_count (при распределенном обучении);
+  // часть, в свою очередь, делится между потоками управления
+  void set_shard(size_t shard_idx, size_t shards_count)
+  {
+    shard = shard_idx;
+    shards = std::max<size_t>(shards_count, 1);
+  }
+  // подготовительные действия, выполняемые перед каждой эпохой обучения
+  bool epoch_prepare(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    t_environment.fi = fopen(pairs_filename.c_str(), "rb");
+    if ( t_environment.fi == nullptr )
+    {
+      std::cerr << "PairsFileLearningExampleProvider: epoch prepare error: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    // пары делятся между потоками точно (по номерам пар), т.к. все записи имеют одинаковый размер
+    const uint64_t parts = threads_count * shards;
+    const uint64_t part = shard * threads_count + threadIndex;
+    const uint64_t first_pair = pairs_count * part / parts;
+    const uint64_t last_pair = pairs_count * (part + 1) / parts;
+    int succ = fseek(t_environment.fi, sizeof(PairsFileHeader) + first_pair * 2 * sizeof(uint32_t), SEEK_SET);
+    if (succ != 0)
+    {
+      std::cerr << "PairsFileLearningExampleProvider: epoch prepare error: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    t_environment.buffer.resize(PAIRS_READ_BUFFER * 2);
+    t_environment.buffer_pos = 0;
+    t_environment.buffer_len = 0;
+    t_environment.pairs_left = last_pair - first_pair;
+    t_environment.pairs_read = 0;
+    return true;
+  } // method-end
+  // заключительные действия, выполняемые после каждой эпохи обучения
+  bool epoch_unprepare(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    fclose( t_environment.fi );
+    return true;
+  }
+  // получение очередного обучающего примера: слово и контексты, заданные идущими подряд парами с этим словом
+  std::optional<LearningExample> get(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    while (true)
+    {
+      if ( !fill_buffer(t_environment) )  // это признак конца эпохи
+        return std::nullopt;
+      LearningExample result;
+      result.word = t_environment.buffer[t_environment.buffer_pos * 2];
+      do
+      {
+        const uint32_t ctx = t_environment.buffer[t_environment.buffer_pos * 2 + 1];
+        ++t_environment.buffer_pos;
+        ++t_environment.pairs_read;
+        profile_count(pcWordsRead);
+        if (ctx < contexts_vocab_size)
+          result.context.push_back(ctx);
+      } while ( fill_buffer(t_environment) && t_environment.buffer[t_environment.buffer_pos * 2] == result.word );
+      if (result.word >= words_vocab_size || result.context.empty()) continue;  // поврежденные записи пропускаем
+      // The subsampling randomly discards frequent words while keeping the ranking same
+      if ( subsampling.enabled() )
+      {
+        profile_section(psInputSubsampling);
+        t_environment.update_random();
+        bool discard = subsampling.discard(result.word, t_environment.next_random);
+        profile_section(psInputTokenize);
+        if (discard)
+        {
+          profile_count(pcWordsDiscarded);
+          continue;
+        }
+      }
+      return result;
+    }
+  } // method-end
+  // получение количества пар, фактически считанных из файла (т.е. без учета сабсэмплинга)
+  uint64_t getWordsCount(size_t threadIndex) const
+  {
+    return thread_environment[threadIndex].pairs_read;
+  }
+  // объем памяти, занимаемой поставщиком: буферы пар всех потоков управления, таблица прореживания
+  uint64_t memory_bytes() const
+  {
+    uint64_t bytes = heap_block_bytes(thread_environment.capacity() * sizeof(ThreadEnvironment_pairs)) + subsampling.memory_bytes();
+    for (auto&& t_environment : thread_environment)
+      bytes += heap_block_bytes(t_environment.buffer.capacity() * sizeof(uint32_t));
+    return bytes;
+  }
+private:
+  // информация, описывающая рабочие контексты потоков управления (thread)
+  std::vector<ThreadEnvironment_pairs> thread_environment;
+  // имя файла пар
+  std::string pairs_filename;
+  // размеры словарей (для контроля индексов)
+  size_t words_vocab_size;
+  size_t contexts_vocab_size;
+  // количество пар в файле
+  uint64_t pairs_count = 0;
+  bool valid = false;
+  // пороги прореживания для каждого слова словаря слов
+  SubsamplingTable subsampling;
+  // часть файла, перебираемая данным процессом, и количество частей
+  size_t shard = 0;
+  size_t shards = 1;
+
+  // дочитывание буфера, если он исчерпан; false -- пары части файла данного потока закончились
+  bool fill_buffer(ThreadEnvironment_pairs& t_environment)
+  {
+    if (t_environment.buffer_pos < t_environment.buffer_len) return true;
+    const size_t to_read = static_cast<size_t>( std::min<uint64_t>(t_environment.pairs_left, PAIRS_READ_BUFFER) );
+    const size_t pairs = (to_read > 0) ? fread(t_environment.buffer.data(), 2 * sizeof(uint32_t), to_read, t_environment.fi) : 0;
+    t_environment.pairs_left = (pairs == to_read) ? t_environment.pairs_left - pairs : 0;
+    t_environment.buffer_pos = 0;
+    t_environment.buffer_len = pairs;
+    return pairs > 0;
+  } // method-end
+};
+
+
+#endif /* PAIRS_FILE_LE_PROVIDER_H_ */
@@ -0,0 +1,538 @@
+#ifndef PARAMETER_AVERAGING_H_
+#define PARAMETER_AVERAGING_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include "weights_precision.h"
+
+#ifndef _WIN32
+  #include <unistd.h>
+  #include <netdb.h>
+  #include <sys/types.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+#endif
+
+
+// Распределенное (многопроцессное) обучение с усреднением параметров.
+// Каждый процесс-исполнитель (worker) обучает модель на своей части обучающего множества. Периодически исполнители передают
+// координатору приращения весовых матриц, накопленные со времени предыдущей синхронизации, причем только для изменившихся строк.
+// Координатор усредняет приращения каждой строки по тем исполнителям, которые её изменили (редкие слова встречаются лишь в одной
+// части обучающего множества, и деление на общее количество исполнителей неоправданно ослабляло бы их обучение), и рассылает
+// результат всем исполнителям. Обмен ведется в отдельном потоке управления и не останавливает обучение: исполнитель заменяет
+// собственное приращение строки усредненным, сохраняя обновления, сделанные потоками обучения за время обмена.
+// Исполнитель, закончивший обучение, продолжает участвовать в синхронизации до завершения всех остальных; последняя синхронизация
+// приводит модели всех исполнителей к одному и тому же состоянию.
+// Обмен ведется по TCP; предполагается, что все процессы работают на платформах с одинаковым порядком байт.
+
+
+namespace parameter_averaging_internal
+{
+  const uint64_t MAGIC = 0x77327678'41564731ULL; // "w2vxAVG1"
+  const size_t MATRICES_COUNT = 2;               // syn0 и syn1
+
+  // строки весовой матрицы и их значения (приращения), передаваемые за один раунд синхронизации
+  struct RowsMessage
+  {
+    std::vector<uint64_t> rows;
+    std::vector<float> values;   // rows.size() * dim значений
+    void clear()
+    {
+      rows.clear();
+      values.clear();
+    }
+  };
+
+#ifndef _WIN32
+  inline bool send_all(int fd, const void *data, size_t bytes)
+  {
+    const char *p = static_cast<const char*>(data);
+    while (bytes > 0)
+    {
+      ssize_t sent = ::send(fd, p, bytes, MSG_NOSIGNAL);
+      if (sent <= 0) return false;
+      p += sent;
+      bytes -= sent;
+    }
+    return true;
+  }
+  inline bool recv_all(int fd, void *data, size_t bytes)
+  {
+    char *p = static_cast<char*>(data);
+    while (bytes > 0)
+    {
+      ssize_t received = ::recv(fd, p, bytes, 0);
+      if (received <= 0) return false;
+      p += received;
+      bytes -= received;
+    }
+    return true;
+  }
+  inline bool send_u64(int fd, uint64_t value)
+  {
+    return send_all(fd, &value, sizeof(value));
+  }
+  inline bool recv_u64(int fd, uint64_t& value)
+  {
+    return recv_all(fd, &value, sizeof(value));
+  }
+  inline bool send_rows(int fd, const RowsMessage& msg)
+  {
+    return send_u64(fd, msg.rows.size()) &&
+           send_all(fd, msg.rows.data(), msg.rows.size() * sizeof(uint64_t)) &&
+           send_all(fd, msg.values.data(), msg.values.size() * sizeof(float));
+  }
+  inline bool recv_rows(int fd, RowsMessage& msg, size_t dim)
+  {
+    uint64_t count = 0;
+    if ( !recv_u64(fd, count) ) return false;
+    msg.rows.resize(count);
+    msg.values.resize(count * dim);
+    return recv_all(fd, msg.rows.data(), count * sizeof(uint64_t)) &&
+           recv_all(fd, msg.values.data(), count * dim * sizeof(float));
+  }
+  inline void set_nodelay(int fd)
+  {
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  }
+#endif
+} // namespace parameter_averaging_internal
+
+
+// сторона исполнителя: подключение к координатору и периодическая синхронизация весовых матриц
+class ParameterAveragingWorker
+{
+public:
+  ParameterAveragingWorker()
+  {
+  }
+  ParameterAveragingWorker(const ParameterAveragingWorker&) = delete;
+  ParameterAveragingWorker& operator=(const ParameterAveragingWorker&) = delete;
+  ~ParameterAveragingWorker()
+  {
+#ifndef _WIN32
+    if (fd >= 0) close(fd);
+#endif
+  }
+  // подключение к координатору по адресу "host:port"; в ответ координатор сообщает номер исполнителя и их общее количество
+  // (размеры матриц всех исполнителей должны совпадать)
+  bool connect(const std::string& address, uint64_t in_rows, uint64_t out_rows, uint64_t dim)
+  {
+    using namespace parameter_averaging_internal;
+#ifndef _WIN32
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos)
+    {
+      std::cerr << "Coordinator address must be <host>:<port>" << std::endl;
+      return false;
+    }
+    const std::string host = address.substr(0, colon);
+    const std::string port = address.substr(colon + 1);
+    addrinfo hints, *res = nullptr;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res)
+    {
+      std::cerr << "Can't resolve coordinator address: " << address << std::endl;
+      return false;
+    }
+    // координатор может быть запущен чуть позже исполнителей -- повторяем попытки подключения
+    for (size_t attempt = 0; attempt < 100 && fd < 0; ++attempt)
+    {
+      for (addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next)
+      {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+          close(fd);
+          fd = -1;
+        }
+      }
+      if (fd < 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    freeaddrinfo(res);
+    if (fd < 0)
+    {
+      std::cerr << "Can't connect to coordinator: " << address << std::endl;
+      return false;
+    }
+    set_nodelay(fd);
+    layer1_size = dim;
+    matrix_rows[0] = in_rows;
+    matrix_rows[1] = out_rows;
+    uint64_t hello[4] = {MAGIC, in_rows, out_rows, dim};
+    uint64_t reply[2] = {0, 0};
+    if ( !send_all(fd, hello, sizeof(hello)) || !recv_all(fd, reply, sizeof(reply)) || reply[1] == 0 )
+    {
+      std::cerr << "Coordinator rejected the connection (weight matrix sizes must be the same for all workers)" << std::endl;
+      return false;
+    }
+    worker_rank = reply[0];
+    workers = reply[1];
+    return true;
+#else
+    std::cerr << "Distributed training is not supported on this platform" << std::endl;
+    return false;
+#endif
+  } // method-end
+  size_t rank() const
+  {
+    return worker_rank;
+  }
+  size_t workers_count() const
+  {
+    return workers;
+  }
+  // задание синхронизируемых матриц (после их инициализации); запоминается их исходное состояние
+  void attach(float *syn0, float *syn1, WeightsPrecision weights_precision)
+  {
+    matrices[0] = syn0;
+    matrices[1] = syn1;
+    precision = weights_precision;
+    for (size_t m = 0; m < parameter_averaging_internal::MATRICES_COUNT; ++m)
+    {
+      const size_t bytes = matrix_rows[m] * layer1_size * weights_element_size(precision);
+      snapshots[m].resize( (bytes + sizeof(float) - 1) / sizeof(float) );
+      std::memcpy(snapshots[m].data(), matrices[m], bytes);
+    }
+  }
+  // цикл синхронизации (выполняется в отдельном потоке управления): раунд обмена выполняется каждые interval секунд,
+  // а после окончания обучения (training_finished) -- без задержек, пока все исполнители не закончат обучение
+  void run(double interval, const std::atomic<bool>& training_finished)
+  {
+    size_t round = 0;
+    while (true)
+    {
+      auto round_start = std::chrono::steady_clock::now();
+      while ( !training_finished.load() && std::chrono::duration<double>(std::chrono::steady_clock::now() - round_start).count() < interval )
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      bool all_finished = false;
+      if ( !sync_round(training_finished.load(), all_finished) )
+      {
+        std::cerr << std::endl << "Synchronization with coordinator failed, continuing without it" << std::endl;
+        return;
+      }
+      ++round;
+      if (all_finished) break;
+    }
+    std::cout << std::endl << "Parameter averaging: " << round << " synchronization rounds" << std::endl;
+  } // method-end
+private:
+  int fd = -1;
+  size_t worker_rank = 0;
+  size_t workers = 1;
+  uint64_t layer1_size = 0;
+  uint64_t matrix_rows[parameter_averaging_internal::MATRICES_COUNT] = {0, 0};
+  float* matrices[parameter_averaging_internal::MATRICES_COUNT] = {nullptr, nullptr};
+  // состояние матриц после предыдущей синхронизации (элементы формата хранения весов)
+  std::vector<float> snapshots[parameter_averaging_internal::MATRICES_COUNT];
+  WeightsPrecision precision = wpFloat32;
+  parameter_averaging_internal::RowsMessage own[parameter_averaging_internal::MATRICES_COUNT];
+  parameter_averaging_internal::RowsMessage merged[parameter_averaging_internal::MATRICES_COUNT];
+
+  // один раунд обмена: отправка собственных приращений, получение и применение усредненных
+  bool sync_round(bool finished, bool& all_finished)
+  {
+    using namespace parameter_averaging_internal;
+#ifndef _WIN32
+    for (size_t m = 0; m < MATRICES_COUNT; ++m)
+      dispatch(m, [this, m](auto *matrix, auto *snapshot) { collect_deltas(matrix, snapshot, matrix_rows[m], own[m]); });
+    if ( !send_u64(fd, finished ? 1 : 0) ) return false;
+    for (size_t m = 0; m < MATRICES_COUNT; ++m)
+      if ( !send_rows(fd, own[m]) ) return false;
+    uint64_t all_finished_flag = 0;
+    if ( !recv_u64(fd, all_finished_flag) ) return false;
+    for (size_t m = 0; m < MATRICES_COUNT; ++m)
+      if ( !recv_rows(fd, merged[m], layer1_size) ) return false;
+    for (size_t m = 0; m < MATRICES_COUNT; ++m)
+      dispatch(m, [this, m, finished](auto *matrix, auto *snapshot) { apply_merged(matrix, snapshot, own[m], merged[m], finished); });
+    all_finished = (all_finished_flag != 0);
+    return true;
+#else
+    return false;
+#endif
+  } // method-end
+  // вызов fn(matrix, snapshot) с указателями на элементы формата хранения весов
+  template <typename Fn>
+  void dispatch(size_t m, Fn fn)
+  {
+    switch (precision)
+    {
+      case wpFloat32:  fn(matrices[m], snapshots[m].data()); break;
+      case wpBFloat16: fn(reinterpret_cast<bf16_t*>(matrices[m]), reinterpret_cast<bf16_t*>(snapshots[m].data())); break;
+      case wpFloat16:  fn(reinterpret_cast<fp16_t*>(matrices[m]), reinterpret_cast<fp16_t*>(snapshots[m].data())); break;
+    }
+  }
+  // сбор приращений изменившихся строк (в порядке возрастания индексов)
+  template <typename T>
+  void collect_deltas(const T *matrix, const T *snapshot, size_t rows, parameter_averaging_internal::RowsMessage& msg)
+  {
+    msg.clear();
+    std::vector<float> delta(layer1_size);
+    for (size_t r = 0; r < rows; ++r)
+    {
+      const T *row = matrix + r * layer1_size;
+      const T *snap = snapshot + r * layer1_size;
+      bool changed = false;
+      for (size_t i = 0; i < layer1_size; ++i)
+      {
+        delta[i] = to_float(row[i]) - to_float(snap[i]);
+        changed |= (delta[i] != 0);
+      }
+      if (!changed) continue;
+      msg.rows.push_back(r);
+      msg.values.insert(msg.values.end(), delta.begin(), delta.end());
+    }
+  }
+  // применение усредненных приращений: собственное приращение строки заменяется усредненным
+  // (по окончании обучения строке просто присваивается новое общее состояние, одинаковое у всех исполнителей)
+  template <typename T>
+  void apply_merged(T *matrix, T *snapshot, const parameter_averaging_internal::RowsMessage& own_msg,
+                    const parameter_averaging_internal::RowsMessage& merged_msg, bool finished)
+  {
+    size_t o = 0;
+    for (size_t k = 0; k < merged_msg.rows.size(); ++k)
+    {
+      const uint64_t r = merged_msg.rows[k];
+      while (o < own_msg.rows.size() && own_msg.rows[o] < r) ++o;
+      const float *own_delta = (o < own_msg.rows.size() && own_msg.rows[o] == r) ? &own_msg.values[o * layer1_size] : nullptr;
+      const float *avg_delta = &merged_msg.values[k * layer1_size];
+      T *row = matrix + r * layer1_size;
+      T *snap = snapshot + r * layer1_size;
+      for (size_t i = 0; i < layer1_size; ++i)
+      {
+        store_nearest(snap[i], to_float(snap[i]) + avg_delta[i]);
+        if (finished)
+          row[i] = snap[i];
+        else
+          store_stochastic(row[i], to_float(row[i]) + avg_delta[i] - (own_delta ? own_delta[i] : 0.0f));
+      }
+    }
+  } // method-end
+}; // class-decl-end
+
+
+// сторона координатора: прием приращений от всех исполнителей, усреднение и рассылка
+class ParameterAveragingCoordinator
+{
+public:
+  ParameterAveragingCoordinator()
+  {
+  }
+  ParameterAveragingCoordinator(const ParameterAveragingCoordinator&) = delete;
+  ParameterAveragingCoordinator& operator=(const ParameterAveragingCoordinator&) = delete;
+  ~ParameterAveragingCoordinator()
+  {
+#ifndef _WIN32
+    for (int w : worker_fds) close(w);
+    if (listen_fd >= 0) close(listen_fd);
+#endif
+  }
+  // ожидание подключения заданного количества исполнителей
+  bool accept_workers(uint16_t port, size_t workers_count)
+  {
+    using namespace parameter_averaging_internal;
+#ifndef _WIN32
+    listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    bool ipv6 = (listen_fd >= 0);
+    if (!ipv6) listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) { std::cerr << "Can't create socket" << std::endl; return false; }
+    int flag = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    int bind_result = -1;
+    if (ipv6)
+    {
+      int v6only = 0;
+      setsockopt(listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+      sockaddr_in6 addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin6_family = AF_INET6;
+      addr.sin6_addr = in6addr_any;
+      addr.sin6_port = htons(port);
+      bind_result = bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+    else
+    {
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons(port);
+      bind_result = bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+    if (bind_result != 0 || listen(listen_fd, static_cast<int>(workers_count)) != 0)
+    {
+      std::cerr << "Can't listen on port " << port << ": " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    std::cout << "Waiting for " << workers_count << " workers on port " << port << std::endl;
+    while (worker_fds.size() < workers_count)
+    {
+      int w = accept(listen_fd, nullptr, nullptr);
+      if (w < 0) continue;
+      set_nodelay(w);
+      uint64_t hello[4] = {0, 0, 0, 0};
+      if ( !recv_all(w, hello, sizeof(hello)) || hello[0] != MAGIC )
+      {
+        close(w);
+        continue;
+      }
+      // размеры матриц задаются первым подключившимся исполнителем
+      if (worker_fds.empty())
+      {
+        matrix_rows[0] = hello[1];
+        matrix_rows[1] = hello[2];
+        layer1_size = hello[3];
+      }
+      else if (hello[1] != matrix_rows[0] || hello[2] != matrix_rows[1] || hello[3] != layer1_size)
+      {
+        std::cerr << "Worker with incompatible weight matrices rejected" << std::endl;
+        uint64_t reject[2] = {0, 0};
+        send_all(w, reject, sizeof(reject));
+        close(w);
+        continue;
+      }
+      worker_fds.push_back(w);
+      std::cout << "Worker " << worker_fds.size() - 1 << " connected" << std::endl;
+    }
+    for (size_t rank = 0; rank < worker_fds.size(); ++rank)
+    {
+      uint64_t reply[2] = {rank, worker_fds.size()};
+      if ( !send_all(worker_fds[rank], reply, sizeof(reply)) ) return false;
+    }
+    return true;
+#else
+    std::cerr << "Distributed training is not supported on this platform" << std::endl;
+    return false;
+#endif
+  } // method-end
+  // обслуживание раундов синхронизации до окончания обучения всеми исполнителями
+  bool serve()
+  {
+    using namespace parameter_averaging_internal;
+#ifndef _WIN32
+    RowsMessage received;
+    RowsMessage merged[MATRICES_COUNT];
+    for (size_t round = 1; ; ++round)
+    {
+      bool all_finished = true;
+      for (size_t m = 0; m < MATRICES_COUNT; ++m)
+        reset(m);
+      // принимаем приращения от каждого исполнителя (порядок сообщений внутри соединения фиксирован протоколом)
+      for (size_t w = 0; w < worker_fds.size(); ++w)
+      {
+        uint64_t finished = 0;
+        if ( !recv_u64(worker_fds[w], finished) )
+        {
+          std::cerr << "Worker " << w << " disconnected" << std::endl;
+          return false;
+        }
+        all_finished &= (finished != 0);
+        for (size_t m = 0; m < MATRICES_COUNT; ++m)
+        {
+          if ( !recv_rows(worker_fds[w], received, layer1_size) )
+          {
+            std::cerr << "Worker " << w << " disconnected" << std::endl;
+            return false;
+          }
+          accumulate(m, received);
+        }
+      }
+      size_t merged_rows[MATRICES_COUNT];
+      for (size_t m = 0; m < MATRICES_COUNT; ++m)
+      {
+        average(m, merged[m]);
+        merged_rows[m] = merged[m].rows.size();
+      }
+      for (size_t w = 0; w < worker_fds.size(); ++w)
+      {
+        bool ok = send_u64(worker_fds[w], all_finished ? 1 : 0);
+        for (size_t m = 0; m < MATRICES_COUNT && ok; ++m)
+          ok = send_rows(worker_fds[w], merged[m]);
+        if (!ok)
+        {
+          std::cerr << "Worker " << w << " disconnected" << std::endl;
+          return false;
+        }
+      }
+      std::cout << "Round " << round << ": averaged rows syn0 " << merged_rows[0] << ", syn1 " << merged_rows[1] << std::endl;
+      if (all_finished) break;
+    }
+    return true;
+#else
+    return false;
+#endif
+  } // method-end
+private:
+  int listen_fd = -1;
+  std::vector<int> worker_fds;
+  uint64_t layer1_size = 0;
+  uint64_t matrix_rows[parameter_averaging_internal::MATRICES_COUNT] = {0, 0};
+  // накопители раунда: слот строки, суммы приращений и количество приславших строку исполнителей
+  std::unordered_map<uint64_t, size_t> slots[parameter_averaging_internal::MATRICES_COUNT];
+  std::vector<uint64_t> slot_rows[parameter_averaging_internal::MATRICES_COUNT];
+  std::vector<float> sums[parameter_averaging_internal::MATRICES_COUNT];
+  std::vector<uint32_t> counts[parameter_averaging_internal::MATRICES_COUNT];
+
+  void reset(size_t m)
+  {
+    slots[m].clear();
+    slot_rows[m].clear();
+    sums[m].clear();
+    counts[m].clear();
+  }
+  void accumulate(size_t m, const parameter_averaging_internal::RowsMessage& msg)
+  {
+    for (size_t k = 0; k < msg.rows.size(); ++k)
+    {
+      if (msg.rows[k] >= matrix_rows[m]) continue;
+      auto it = slots[m].find(msg.rows[k]);
+      size_t slot = 0;
+      if (it == slots[m].end())
+      {
+        slot = slot_rows[m].size();
+        slots[m].emplace(msg.rows[k], slot);
+        slot_rows[m].push_back(msg.rows[k]);
+        sums[m].resize(sums[m].size() + layer1_size, 0.0f);
+        counts[m].push_back(0);
+      }
+      else
+        slot = it->second;
+      std::transform(&sums[m][slot * layer1_size], &sums[m][slot * layer1_size] + layer1_size, &msg.values[k * layer1_size],
+                     &sums[m][slot * layer1_size], std::plus<float>());
+      ++counts[m][slot];
+    }
+  }
+  // усредненные приращения в порядке возрастания индексов строк
+  void average(size_t m, parameter_averaging_internal::RowsMessage& msg)
+  {
+    std::vector<size_t> order(slot_rows[m].size());
+    for (size_t s = 0; s < order.size(); ++s) order[s] = s;
+    std::sort(order.begin(), order.end(), [this, m](size_t a, size_t b) { return slot_rows[m][a] < slot_rows[m][b]; });
+    msg.rows.resize(order.size());
+    msg.values.resize(order.size() * layer1_size);
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+      const size_t slot = order[k];
+      msg.rows[k] = slot_rows[m][slot];
+      for (size_t i = 0; i < layer1_size; ++i)
+        msg.values[k * layer1_size + i] = sums[m][slot * layer1_size + i] / counts[m][slot];
+    }
+  }
+}; // class-decl-end
+
+
+#endif /* PARAMETER_AVERAGING_H_ */
@@ -0,0 +1,485 @@
+#ifndef PHRASES_H_
+#define PHRASES_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "corpus_reader.h"
+#include "tokenizer.h"
+
+
+// Параллельный подсчет частот токенов обучающего множества (build_dict) и выделение словосочетаний -- аналог word2phrase
+// оригинального word2vec. Обучающее множество делится на части (CorpusUnit): единственный несжатый файл -- на диапазоны,
+// границы которых совпадают с началами строк, иначе частью является каждый файл. Части обрабатываются потоками управления
+// по мере освобождения (сначала большие). Каждый поток считает частоты в собственной таблице, по окончании таблицы
+// объединяются. Объем таблиц ограничен: при превышении лимита, как и в word2vec, удаляются самые редкие записи.
+// Словосочетания выделяются за два прохода: сначала считаются частоты слов и пар соседних слов (биграмм), затем
+// обучающее множество переписывается, и пары с оценкой выше порога объединяются в один токен через '_':
+//   score(a, b) = (cn(a_b) - min_count) / cn(a) / cn(b) * train_words
+// Слово, вошедшее в словосочетание, не объединяется со следующим (за проход выделяются словосочетания из двух слов,
+// повторный проход по результату дает словосочетания длиннее). Словосочетания не пересекают границы строк.
+// Лимит записей делится между потоками поровну, и каждый поток удаляет редкие записи по собственным частотам (примерно в T раз
+// меньшим общих при T потоках), так что при достижении лимита отсечение в нескольких потоках агрессивнее, чем в одном, и
+// словарь и словосочетания могут зависеть от -threads; пока лимит не достигнут, результат от количества потоков не зависит.
+
+
+// часть обучающего множества: файл целиком либо диапазон байт [begin; end) несжатого файла
+struct CorpusUnit
+{
+  std::string filename;
+  uint64_t begin = 0;
+  uint64_t end = std::numeric_limits<uint64_t>::max();
+  uint64_t size = 0;   // размер (для очередности обработки)
+};
+
+
+// разбиение обучающего множества на части; единственный несжатый файл делится на parts диапазонов по границам строк
+inline std::vector<CorpusUnit> split_corpus(const std::vector<std::string>& files, size_t parts)
+{
+  std::vector<CorpusUnit> units;
+  for (auto&& filename : files)
+  {
+    CorpusUnit unit;
+    unit.filename = filename;
+    std::ifstream ifs(filename, std::ios::binary|std::ios::ate);
+    unit.size = ifs.good() ? static_cast<uint64_t>(ifs.tellg()) : 0;
+    units.push_back(unit);
+  }
+  if (files.size() != 1 || parts < 2 || CorpusReader::detect_format(files[0]) != cffPlain)
+    return units;
+  const CorpusUnit whole = units[0];
+  units.clear();
+  uint64_t begin = 0;
+  for (size_t p = 1; p <= parts; ++p)
+  {
+    uint64_t end = whole.size;
+    if (p < parts)
+    {
+      // граница сдвигается к началу строки, следующей за расчетной позицией
+      end = whole.size / parts * p;
+      CorpusReader reader;
+      if ( end > begin && reader.open(whole.filename, end - 1) )
+      {
+        int ch;
+        while ( (ch = reader.get()) != EOF && ch != '\n' ) {}
+        end = reader.tell();
+      }
+      end = std::max(end, begin);
+    }
+    CorpusUnit unit = whole;
+    unit.begin = begin;
+    unit.end = (p < parts) ? end : std::numeric_limits<uint64_t>::max();
+    unit.size = end - begin;
+    units.push_back(unit);
+    begin = end;
+  }
+  return units;
+} // function-end
+
+
+// последовательное чтение токенов части обучающего множества ("</s>" -- конец строки)
+class CorpusUnitReader
+{
+public:
+  bool open(const CorpusUnit& corpus_unit)
+  {
+    unit = corpus_unit;
+    if ( !reader.open(unit.filename, unit.begin) )
+    {
+      std::cerr << "Train-file open: error: " << unit.filename << std::endl;
+      return false;
+    }
+    return true;
+  }
+  // чтение очередного токена; false -- часть прочитана
+  // (граница диапазона -- начало строки, поэтому она достигается сразу после чтения конца предыдущей строки)
+  bool next(std::string& word)
+  {
+    if (reader.eof() || reader.tell() >= unit.end) return false;
+    read_word(reader, word);
+    return !reader.eof();
+  }
+private:
+  CorpusUnit unit;
+  CorpusReader reader;
+}; // class-decl-end
+
+
+// вывод в консоль из потоков обработки частей (сообщения разных потоков не перемешиваются)
+inline std::mutex& console_mutex()
+{
+  static std::mutex mtx;
+  return mtx;
+}
+
+
+// обработка частей обучающего множества в threads_count потоках управления: fn(thread_idx, unit_idx)
+template <typename UnitFunction>
+void process_units_in_parallel(const std::vector<CorpusUnit>& units, size_t threads_count, UnitFunction&& fn)
+{
+  std::vector<size_t> order(units.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&units](size_t a, size_t b) { return units[a].size > units[b].size; });
+  std::atomic<size_t> next_unit(0);
+  std::vector<std::thread> threads_vec;
+  threads_vec.reserve(threads_count);
+  for (size_t t = 0; t < threads_count; ++t)
+    threads_vec.emplace_back([&, t]()
+                             {
+                               for (size_t i = next_unit++; i < order.size(); i = next_unit++)
+                                 fn(t, order[i]);
+                             });
+  for (auto& thread : threads_vec)
+    thread.join();
+} // function-end
+
+
+// вывод прогресса (общего для всех потоков количества прочитанных токенов)
+class ProgressCounter
+{
+public:
+  // учет очередного токена потоком (local -- счетчик потока)
+  inline void tick(uint64_t& local)
+  {
+    if (++local % STEP != 0) return;
+    const uint64_t total = (words += STEP);
+    std::lock_guard<std::mutex> lock( console_mutex() );
+    std::cout << '\r' << (total / 1000) << " K     ";
+    std::cout.flush();
+  }
+private:
+  static const uint64_t STEP = 100000;
+  std::atomic<uint64_t> words{0};
+}; // class-decl-end
+
+
+// таблица частот токенов с ограниченным количеством записей:
+// при превышении лимита удаляются записи с частотой не выше текущего порога, и порог увеличивается (ReduceVocab в word2vec)
+class TokenCounter
+{
+public:
+  explicit TokenCounter(size_t maxEntries)
+  : max_entries(std::max<size_t>(maxEntries, 1))
+  {
+  }
+  inline void add(const std::string& token, uint64_t cn = 1)
+  {
+    auto it = dict.find(token);
+    if (it == dict.end())
+      dict[token] = cn;
+    else
+      it->second += cn;
+    if (dict.size() > max_entries)
+      reduce();
+  }
+  // частота токена (0, если его нет в таблице)
+  inline uint64_t count(const std::string& token) const
+  {
+    auto it = dict.find(token);
+    return (it == dict.end()) ? 0 : it->second;
+  }
+  // перенос частот другой таблицы в данную (другая таблица освобождается)
+  void merge(TokenCounter& other)
+  {
+    // в пустую таблицу другая переносится целиком (при одном потоке управления словарь совпадает с построенным последовательно)
+    if ( dict.empty() )
+    {
+      dict.swap(other.dict);
+      min_reduce = std::max(min_reduce, other.min_reduce);
+      std::unordered_map<std::string, uint64_t>().swap(other.dict);
+      if (dict.size() > max_entries)
+        reduce();
+      return;
+    }
+    for (auto&& [token, cn] : other.dict)
+      add(token, cn);
+    std::unordered_map<std::string, uint64_t>().swap(other.dict);
+  }
+  // удаление записей с частотой ниже min_count
+  void prune(uint64_t min_count)
+  {
+    for (auto it = dict.begin(); it != dict.end(); )
+    {
+      if (it->second >= min_count)
+        ++it;
+      else
+        it = dict.erase(it);
+    }
+  }
+  const std::unordered_map<std::string, uint64_t>& counts() const
+  {
+    return dict;
+  }
+private:
+  std::unordered_map<std::string, uint64_t> dict;
+  size_t max_entries;
+  uint64_t min_reduce = 1;
+
+  void reduce()
+  {
+    {
+      std::lock_guard<std::mutex> lock( console_mutex() );
+      std::cout << std::endl << "Reduce!" << std::endl;
+    }
+    auto it = dict.begin();
+    while (it != dict.end())
+    {
+      if (it->second > min_reduce)
+        ++it;
+      else
+        it = dict.erase(it);
+    }
+    ++min_reduce;
+  }
+}; // class-decl-end
+
+
+// подсчет частот токенов обучающего множества в threads_count потоках управления (общий лимит записей -- max_entries);
+// концы строк ("</s>") в таблицу не попадают, а подсчитываются в eol_count
+inline void count_tokens(const std::vector<CorpusUnit>& units, size_t threads_count, size_t max_entries, TokenCounter& result, uint64_t& eol_count)
+{
+  std::vector<TokenCounter> counters(threads_count, TokenCounter(max_entries / threads_count));
+  std::vector<uint64_t> eols(threads_count, 0), words(threads_count, 0);
+  ProgressCounter progress;
+  process_units_in_parallel(units, threads_count, [&](size_t t, size_t u)
+                            {
+                              CorpusUnitReader reader;
+                              if ( !reader.open(units[u]) ) return;
+                              std::string word;
+                              while ( reader.next(word) )
+                              {
+                                progress.tick(words[t]);
+                                if (word == "</s>")
+                                  ++eols[t];
+                                else
+                                  counters[t].add(word);
+                              }
+                            });
+  eol_count = std::accumulate(eols.begin(), eols.end(), static_cast<uint64_t>(0));
+  for (auto&& counter : counters)
+    result.merge(counter);
+} // function-end
+
+
+// выделение словосочетаний
+class PhraseDetector
+{
+public:
+  // конструктор; minCount -- порог частоты слов и биграмм, threshold -- порог оценки, maxEntries -- общий лимит записей таблиц частот
+  PhraseDetector(size_t threadsCount, size_t maxEntries, uint64_t minCount, double threshold)
+  : threads_count(std::max<size_t>(threadsCount, 1))
+  , max_entries(maxEntries)
+  , min_count(minCount)
+  , score_threshold(threshold)
+  , counts(maxEntries)
+  {
+  }
+  // первый проход: подсчет частот слов и биграмм
+  void count(const std::vector<CorpusUnit>& units)
+  {
+    std::vector<TokenCounter> counters(threads_count, TokenCounter(max_entries / threads_count));
+    std::vector<uint64_t> words(threads_count, 0), read(threads_count, 0);
+    ProgressCounter progress;
+    process_units_in_parallel(units, threads_count, [&](size_t t, size_t u)
+                              {
+                                CorpusUnitReader reader;
+                                if ( !reader.open(units[u]) ) return;
+                                std::string word, last_word, bigram;
+                                while ( reader.next(word) )
+                                {
+                                  progress.tick(read[t]);
+                                  if (word == "</s>")
+                                  {
+                                    last_word.clear();
+                                    continue;
+                                  }
+                                  ++words[t];
+                                  counters[t].add(word);
+                                  if ( !last_word.empty() && make_bigram(last_word, word, bigram) )
+                                    counters[t].add(bigram);
+                                  last_word.swap(word);
+                                }
+                              });
+    train_words = std::accumulate(words.begin(), words.end(), static_cast<uint64_t>(0));
+    for (auto&& counter : counters)
+      counts.merge(counter);
+    counts.prune(min_count);
+    std::cout << std::endl << "Words in train file: " << train_words << ", words and bigrams above min-count: " << counts.counts().size() << std::endl;
+  } // method-end
+  // второй проход: запись обучающего множества со словосочетаниями в файл output_filename и подсчет частот его токенов
+  // (части записываются потоками во временные файлы <output_filename>.part<N>, которые затем склеиваются по порядку)
+  bool rewrite(const std::vector<CorpusUnit>& units, const std::string& output_filename, TokenCounter& vocabulary, uint64_t& eol_count)
+  {
+    std::vector<TokenCounter> counters(threads_count, TokenCounter(max_entries / threads_count));
+    std::vector<uint64_t> eols(threads_count, 0), phrases(threads_count, 0), read(threads_count, 0);
+    std::atomic<bool> failed(false);
+    ProgressCounter progress;
+    process_units_in_parallel(units, threads_count, [&](size_t t, size_t u)
+                              {
+                                if ( !rewrite_unit(units[u], part_filename(output_filename, u), counters[t], eols[t], phrases[t], progress, read[t]) )
+                                  failed = true;
+                              });
+    eol_count = std::accumulate(eols.begin(), eols.end(), static_cast<uint64_t>(0));
+    for (auto&& counter : counters)
+      vocabulary.merge(counter);
+    std::cout << std::endl << "Phrases joined: " << std::accumulate(phrases.begin(), phrases.end(), static_cast<uint64_t>(0)) << std::endl;
+    if (failed)
+    {
+      for (size_t u = 0; u < units.size(); ++u)
+        std::remove(part_filename(output_filename, u).c_str());
+      return false;
+    }
+    return concatenate_parts(output_filename, units.size());
+  } // method-end
+private:
+  // размер буфера записи потока
+  static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+  size_t threads_count;
+  size_t max_entries;
+  uint64_t min_count;
+  double score_threshold;
+  // частоты слов и биграмм (после первого прохода) и количество слов обучающего множества
+  TokenCounter counts;
+  uint64_t train_words = 0;
+
+  // биграмма "a_b"; false, если она длиннее MAX_STRING (такой токен был бы обрезан при чтении)
+  static bool make_bigram(const std::string& a, const std::string& b, std::string& bigram)
+  {
+    if (a.size() + 1 + b.size() > MAX_STRING) return false;
+    bigram.assign(a).append(1, '_').append(b);
+    return true;
+  }
+  static std::string part_filename(const std::string& output_filename, size_t unit_idx)
+  {
+    return output_filename + ".part" + std::to_string(unit_idx);
+  }
+  // запись одной части; vocabulary, eol_count, phrases_count -- счетчики потока
+  bool rewrite_unit(const CorpusUnit& unit, const std::string& filename, TokenCounter& vocabulary, uint64_t& eol_count, uint64_t& phrases_count,
+                    ProgressCounter& progress, uint64_t& read)
+  {
+    CorpusUnitReader reader;
+    FILE *fo = fopen(filename.c_str(), "wb");
+    if (fo == nullptr)
+    {
+      std::cerr << "Output-file open: error: " << filename << ": " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    const bool opened = reader.open(unit);
+    std::string out, word, last_word, bigram, token;
+    out.reserve(WRITE_BUFFER_SIZE + MAX_STRING + 2);
+    uint64_t last_cn = 0;   // частота предыдущего слова; 0 -- предыдущее слово уже вошло в словосочетание (или его нет)
+    while ( opened && reader.next(word) )
+    {
+      progress.tick(read);
+      if (word == "</s>")
+      {
+        if ( !token.empty() ) vocabulary.add(token);
+        token.clear();
+        last_word.clear();
+        last_cn = 0;
+        out.push_back('\n');
+        ++eol_count;
+      }
+      else
+      {
+        const uint64_t cn = counts.count(word);
+        bool join = false;
+        if ( last_cn >= min_count && cn >= min_count && make_bigram(last_word, word, bigram) )
+        {
+          const uint64_t bigram_cn = counts.count(bigram);
+          join = bigram_cn > min_count && (bigram_cn - min_count) / static_cast<double>(last_cn) / cn * train_words > score_threshold;
+        }
+        if (join)
+        {
+          out.push_back('_');
+          token.append(1, '_').append(word);
+          ++phrases_count;
+        }
+        else
+        {
+          if ( !token.empty() )
+          {
+            vocabulary.add(token);
+            out.push_back(' ');
+          }
+          token = word;
+        }
+        out.append(word);
+        last_cn = join ? 0 : cn;
+        last_word.swap(word);
+      }
+      if (out.size() >= WRITE_BUFFER_SIZE)
+      {
+        fwrite(out.data(), 1, out.size(), fo);
+        out.clear();
+      }
+    }
+    // незавершенная строка завершается, чтобы при склейке частей она не слилась с первой строкой следующей части
+    if ( !token.empty() )
+    {
+      vocabulary.add(token);
+      out.push_back('\n');
+      ++eol_count;
+    }
+    fwrite(out.data(), 1, out.size(), fo);
+    const bool written = !ferror(fo);
+    if (fclose(fo) != 0 || !written)
+    {
+      std::cerr << "Output-file write: error: " << filename << ": " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    return opened;
+  } // method-end
+  // склейка временных файлов частей в файл output_filename (к первой части дописываются остальные, затем она переименовывается)
+  static bool concatenate_parts(const std::string& output_filename, size_t units_count)
+  {
+    bool ok = true;
+    FILE *fo = fopen(part_filename(output_filename, 0).c_str(), "ab");
+    if (fo == nullptr)
+    {
+      std::cerr << "Output-file open: error: " << part_filename(output_filename, 0) << ": " << std::strerror(errno) << std::endl;
+      ok = false;
+    }
+    std::vector<char> buffer(WRITE_BUFFER_SIZE);
+    for (size_t u = 1; u < units_count; ++u)
+    {
+      const std::string filename = part_filename(output_filename, u);
+      FILE *fi = ok ? fopen(filename.c_str(), "rb") : nullptr;
+      if (ok && fi == nullptr)
+      {
+        std::cerr << "Part-file open: error: " << filename << ": " << std::strerror(errno) << std::endl;
+        ok = false;
+      }
+      size_t n;
+      while ( ok && (n = fread(buffer.data(), 1, buffer.size(), fi)) > 0 )
+        ok = (fwrite(buffer.data(), 1, n, fo) == n);
+      if (fi != nullptr)
+        fclose(fi);
+      std::remove(filename.c_str());
+    }
+    if (fo != nullptr && fclose(fo) != 0)
+      ok = false;
+    if ( ok && std::rename(part_filename(output_filename, 0).c_str(), output_filename.c_str()) != 0 )
+      ok = false;
+    if (!ok)
+    {
+      std::cerr << "Output-file write: error: " << output_filename << ": " << std::strerror(errno) << std::endl;
+      std::remove(part_filename(output_filename, 0).c_str());
+    }
+    return ok;
+  } // method-end
+}; // class-decl-end
+
+
+#endif /* PHRASES_H_ */
@@ -0,0 +1,324 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <csignal>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+
+// Средства профилирования.
+//
+// SimpleProfiler -- замер общего времени работы утилиты (выводится при разрушении объекта).
+//
+// Profiler -- пофазовый учет времени и счетчиков для каждого потока управления (thread).
+// Время потока делится на секции; поток в каждый момент находится ровно в одной секции, а переключение секций
+// (profile_section) фиксирует время, проведенное в предыдущей. Таким образом, на одно переключение приходится одно чтение часов,
+// а сумма секций в точности равна времени работы потока. Если профилирование не включено, переключение сводится к проверке
+// thread_local указателя.
+// Сводка выводится по завершении обучения, а также по сигналу SIGUSR1 (на платформах, где он есть); её можно выгрузить в JSON.
+// Количество страничных прерываний (page faults) потока учитывается на Linux по завершении потока.
+
+
+class SimpleProfiler
+{
+public:
+  SimpleProfiler()
+  {
+    start_tp = std::chrono::steady_clock::now();
+  }
+  ~SimpleProfiler()
+  {
+    auto finish_tp = std::chrono::steady_clock::now();
+//    std::chrono::duration<double, std::milli> ms = finish_tp - start_tp;
+//    std::cout << std::fixed << "  time elapsed: " << ms.count() << " ms" << std::endl;
+    std::chrono::duration< double, std::ratio<1> > seconds = finish_tp - start_tp;
+    std::cout << std::fixed << "  time elapsed: " << seconds.count() << " seconds" << std::endl;
+  }
+private:
+  std::chrono::steady_clock::time_point start_tp;
+};
+
+
+// секции профилирования (иерархия задается префиксом имени до символа '/')
+enum ProfileSection
+{
+  psOther,              // служебные действия (вывод прогресса, подготовка потока и т.п.)
+  psInputTokenize,      // чтение обучающего множества и токенизация
+  psInputSubsampling,   // прореживание частотных слов (subsampling)
+  psComputeForward,     // прямой проход: скалярные произведения (и построение выхода скрытого слоя)
+  psComputeBackward,    // обратный проход: обновление весов
+  psComputeHotRowsSync, // синхронизация частных копий горячих строк с общими весовыми матрицами
+  psBarrierIdle,        // простой в ожидании остальных потоков по окончании обучения
+  psSectionsCount
+};
+
+const char* const PROFILE_SECTION_NAMES[psSectionsCount] = {
+  "other",
+  "input/tokenize",
+  "input/subsampling",
+  "compute/forward_dot",
+  "compute/backward_update",
+  "compute/hot_rows_sync",
+  "barrier_idle"
+};
+
+// счетчики
+enum ProfileCounter
+{
+  pcWordsRead,          // прочитано словарных слов
+  pcWordsDiscarded,     // отброшено прореживанием
+  pcExamples,           // обработано обучающих примеров
+  pcDots,               // скалярных произведений с векторами выходного слоя
+  pcPageFaultsMajor,    // страничных прерываний с чтением с диска (при размещении весов в файлах -- подгрузка строк)
+  pcPageFaultsMinor,    // страничных прерываний без чтения с диска
+  pcCountersCount
+};
+
+const char* const PROFILE_COUNTER_NAMES[pcCountersCount] = {
+  "words_read",
+  "words_discarded",
+  "examples",
+  "output_dots",
+  "page_faults_major",
+  "page_faults_minor"
+};
+
+
+// количество страничных прерываний (major -- с чтением с диска, minor -- без него) процесса либо текущего потока;
+// false, если платформа не предоставляет таких сведений
+inline bool page_faults(uint64_t& major, uint64_t& minor, bool current_thread = false)
+{
+  major = minor = 0;
+#ifdef __linux__
+  struct rusage usage;
+  if (getrusage(current_thread ? RUSAGE_THREAD : RUSAGE_SELF, &usage) != 0) return false;
+  major = usage.ru_majflt;
+  minor = usage.ru_minflt;
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+// профиль одного потока управления (выровнен по кэш-линии, чтобы потоки не мешали друг другу)
+struct alignas(64) ThreadProfile
+{
+  // значения пишет только поток-владелец; атомарность нужна лишь для корректного чтения при выводе сводки по сигналу
+  std::atomic<uint64_t> ns[psSectionsCount];
+  std::atomic<uint64_t> counters[pcCountersCount];
+  ProfileSection current = psOther;
+  std::chrono::steady_clock::time_point lap_tp;
+  std::chrono::steady_clock::time_point finish_tp;
+  uint64_t start_faults_major = 0, start_faults_minor = 0;
+  ThreadProfile()
+  {
+    for (auto& v : ns) v.store(0, std::memory_order_relaxed);
+    for (auto& v : counters) v.store(0, std::memory_order_relaxed);
+  }
+  inline void add_ns(ProfileSection section, uint64_t value)
+  {
+    ns[section].store(ns[section].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+  inline void add_counter(ProfileCounter counter, uint64_t value)
+  {
+    counters[counter].store(counters[counter].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+};
+
+// профиль текущего потока (nullptr, если профилирование выключено)
+inline thread_local ThreadProfile* tls_profile = nullptr;
+
+// переключение текущего потока в заданную секцию
+inline void profile_section(ProfileSection section)
+{
+  ThreadProfile* p = tls_profile;
+  if (!p) return;
+  auto now = std::chrono::steady_clock::now();
+  p->add_ns(p->current, std::chrono::duration_cast<std::chrono::nanoseconds>(now - p->lap_tp).count());
+  p->lap_tp = now;
+  p->current = section;
+}
+
+// приращение счетчика текущего потока
+inline void profile_count(ProfileCounter counter, uint64_t value = 1)
+{
+  ThreadProfile* p = tls_profile;
+  if (p) p->add_counter(counter, value);
+}
+
+
+class Profiler
+{
+public:
+  static Profiler& instance()
+  {
+    static Profiler profiler;
+    return profiler;
+  }
+  // включение профилирования для заданного количества потоков; если json_filename не пуст, сводка будет сохранена в этот файл
+  void enable(size_t threads_count, const std::string& json_filename)
+  {
+    profiles.reset( new ThreadProfile[threads_count] );
+    profiles_count = threads_count;
+    json_output = json_filename;
+    start_tp = std::chrono::steady_clock::now();
+    dump_requested().store(false);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, [](int) { dump_requested().store(true); });
+#endif
+  }
+  bool enabled() const
+  {
+    return profiles_count > 0;
+  }
+  // начало работы потока
+  void thread_start(size_t thread_idx)
+  {
+    if (thread_idx >= profiles_count) return;
+    tls_profile = &profiles[thread_idx];
+    tls_profile->current = psOther;
+    tls_profile->lap_tp = std::chrono::steady_clock::now();
+    page_faults(tls_profile->start_faults_major, tls_profile->start_faults_minor, true);
+  }
+  // завершение работы потока
+  void thread_finish()
+  {
+    if (!tls_profile) return;
+    uint64_t major = 0, minor = 0;
+    if ( page_faults(major, minor, true) )
+    {
+      tls_profile->add_counter(pcPageFaultsMajor, major - tls_profile->start_faults_major);
+      tls_profile->add_counter(pcPageFaultsMinor, minor - tls_profile->start_faults_minor);
+    }
+    profile_section(psOther);
+    tls_profile->finish_tp = tls_profile->lap_tp;
+    tls_profile = nullptr;
+  }
+  // вывод промежуточной сводки, если она была запрошена сигналом (вызывается периодически одним из рабочих потоков)
+  void poll_dump_request()
+  {
+    if ( enabled() && dump_requested().exchange(false) )
+    {
+      std::cout << std::endl;
+      print_summary();
+    }
+  }
+  // окончательная сводка (вызывается после завершения всех потоков)
+  void finish()
+  {
+    if (!enabled()) return;
+    // время ожидания остальных потоков на завершающем барьере
+    auto last_finish_tp = start_tp;
+    for (size_t t = 0; t < profiles_count; ++t)
+      last_finish_tp = std::max(last_finish_tp, profiles[t].finish_tp);
+    for (size_t t = 0; t < profiles_count; ++t)
+      profiles[t].add_ns(psBarrierIdle, std::chrono::duration_cast<std::chrono::nanoseconds>(last_finish_tp - profiles[t].finish_tp).count());
+    std::cout << std::endl;
+    print_summary();
+    if (!json_output.empty())
+      save_json(json_output);
+  }
+private:
+  std::unique_ptr<ThreadProfile[]> profiles;
+  size_t profiles_count = 0;
+  std::string json_output;
+  std::chrono::steady_clock::time_point start_tp;
+
+  static std::atomic<bool>& dump_requested()
+  {
+    static std::atomic<bool> flag(false);
+    return flag;
+  }
+  // имя родительской секции (до '/') или пустая строка
+  static std::string parent_name(const std::string& name)
+  {
+    auto pos = name.find('/');
+    return (pos == std::string::npos) ? std::string() : name.substr(0, pos);
+  }
+  uint64_t total_ns(size_t thread_idx) const
+  {
+    uint64_t total = 0;
+    for (size_t s = 0; s < psSectionsCount; ++s)
+      total += profiles[thread_idx].ns[s].load(std::memory_order_relaxed);
+    return total;
+  }
+  void print_summary() const
+  {
+    printf("Profile (seconds, %% of thread time):\n");
+    printf("  %-26s", "section");
+    for (size_t t = 0; t < profiles_count; ++t)
+      printf("  thread %-10zu", t);
+    printf("\n");
+    std::string last_parent;
+    for (size_t s = 0; s < psSectionsCount; ++s)
+    {
+      std::string name = PROFILE_SECTION_NAMES[s];
+      std::string parent = parent_name(name);
+      // строка родительской секции выводится перед первой из дочерних
+      if (!parent.empty() && parent != last_parent)
+      {
+        printf("  %-26s", parent.c_str());
+        for (size_t t = 0; t < profiles_count; ++t)
+        {
+          uint64_t ns = 0;
+          for (size_t c = s; c < psSectionsCount && parent_name(PROFILE_SECTION_NAMES[c]) == parent; ++c)
+            ns += profiles[t].ns[c].load(std::memory_order_relaxed);
+          print_cell(ns, total_ns(t));
+        }
+        printf("\n");
+      }
+      last_parent = parent;
+      printf("  %-26s", (parent.empty() ? name : "  " + name.substr(parent.size() + 1)).c_str());
+      for (size_t t = 0; t < profiles_count; ++t)
+        print_cell(profiles[t].ns[s].load(std::memory_order_relaxed), total_ns(t));
+      printf("\n");
+    }
+    for (size_t c = 0; c < pcCountersCount; ++c)
+    {
+      printf("  %-26s", PROFILE_COUNTER_NAMES[c]);
+      for (size_t t = 0; t < profiles_count; ++t)
+        printf("  %-17lu", profiles[t].counters[c].load(std::memory_order_relaxed));
+      printf("\n");
+    }
+    fflush(stdout);
+  }
+  static void print_cell(uint64_t ns, uint64_t total)
+  {
+    printf("  %8.3f (%5.1f%%)", ns / 1e9, total ? 100.0 * ns / total : 0.0);
+  }
+  void save_json(const std::string& filename) const
+  {
+    FILE *fo = fopen(filename.c_str(), "wb");
+    if (fo == nullptr)
+    {
+      std::cerr << "Profile: can't save JSON to " << filename << std::endl;
+      return;
+    }
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start_tp;
+    fprintf(fo, "{\n  \"wall_seconds\": %.6f,\n  \"threads\": [\n", wall.count());
+    for (size_t t = 0; t < profiles_count; ++t)
+    {
+      fprintf(fo, "    {\"thread\": %zu, \"sections_ns\": {", t);
+      for (size_t s = 0; s < psSectionsCount; ++s)
+        fprintf(fo, "%s\"%s\": %lu", (s ? ", " : ""), PROFILE_SECTION_NAMES[s], profiles[t].ns[s].load(std::memory_order_relaxed));
+      fprintf(fo, "}, \"counters\": {");
+      for (size_t c = 0; c < pcCountersCount; ++c)
+        fprintf(fo, "%s\"%s\": %lu", (c ? ", " : ""), PROFILE_COUNTER_NAMES[c], profiles[t].counters[c].load(std::memory_order_relaxed));
+      fprintf(fo, "}}%s\n", (t + 1 < profiles_count) ? "," : "");
+    }
+    fprintf(fo, "  ]\n}\n");
+    fclose(fo);
+  }
+};
+
+
+#endif /* PROFILER_H_ */
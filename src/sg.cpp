@@ -1,11 +1,17 @@
 #include <memory>
 #include <string>
 #include <thread>
-#include "simple_profiler.h"
+#include <atomic>
+#include <chrono>
+#include "profiler.h"
 #include "sg_command_line_parameters.h"
 #include "original_word2vec_vocabulary.h"
 #include "original_word2vec_le_provider.h"
+#include "pairs_file_le_provider.h"
 #include "sg_trainer_mikolov.h"
+#include "metrics_exporter.h"
+#include "snapshot_evaluator.h"
+#include "capacity_planner.h"
 
 
 
@@ -16,48 +22,227 @@ int main(int argc, char **argv)
   cmdLineParams.parse(argc, argv);
   cmdLineParams.dbg_cout();
 
-  if (!cmdLineParams.isDefined("-words-vocab") || !cmdLineParams.isDefined("-train") || !cmdLineParams.isDefined("-output"))
+  if (!cmdLineParams.isDefined("-words-vocab") || !cmdLineParams.isDefined("-train") || (!cmdLineParams.isDefined("-output") && !cmdLineParams.isDefined("-dry-run")))
     return 0;
 
   SimpleProfiler global_profiler;
+  const std::chrono::steady_clock::time_point start_tp = std::chrono::steady_clock::now();
 
   // загрузка словаря
   std::shared_ptr< OriginalWord2VecVocabulary> v = std::make_shared< OriginalWord2VecVocabulary>();
   if ( !v->load( cmdLineParams.getAsString("-words-vocab") ) )
     return -1;
+  // количество слов в обучающем множестве (словарь строится по нему же)
+  const uint64_t corpus_words = v->cn_sum();
+  // при заданном словаре контекстов обучение ведется по бинарному файлу пар (слово, контекст), см. pairs_file_le_provider.h
+  std::shared_ptr< OriginalWord2VecVocabulary> c = v;
+  if (cmdLineParams.isDefined("-ctx-vocab"))
+  {
+    if (cmdLineParams.isDefined("-backup") || cmdLineParams.isDefined("-restore"))
+    {
+      std::cerr << "-backup and -restore are not supported with -ctx-vocab" << std::endl;
+      return -1;
+    }
+    c = std::make_shared< OriginalWord2VecVocabulary>();
+    if ( !c->load( cmdLineParams.getAsString("-ctx-vocab") ) )
+      return -1;
+  }
+  // при дообучении словарь сохраненной модели дополняется словами (и частотами) из словаря новых текстов
+  if (cmdLineParams.isDefined("-restore"))
+  {
+    std::vector< std::pair<std::string, uint64_t> > backup_vocabulary;
+    if ( !CustomTrainer::readBackupVocabulary(cmdLineParams.getAsString("-restore"), backup_vocabulary) )
+      return -1;
+    const size_t new_words_vocab_size = v->size();
+    for (auto&& [word, cn] : backup_vocabulary)
+      v->merge(word, cn);
+    v->sort_by_frequency();
+    std::cout << "Vocabulary: " << backup_vocabulary.size() << " words in backup, " << new_words_vocab_size << " words in new data, "
+              << v->size() << " words after merge" << std::endl;
+  }
+
+  // подключение к координатору распределенного обучения: процесс получает свой номер и обучается на своей части обучающего множества
+  // (при планировании ресурсов подключение не выполняется, и расчет ведется для одного процесса на всем обучающем множестве)
+  const bool dry_run = cmdLineParams.isDefined("-dry-run");
+  std::unique_ptr< ParameterAveragingWorker > dist_worker;
+  if (cmdLineParams.isDefined("-dist-coordinator") && !dry_run)
+  {
+    dist_worker = std::make_unique< ParameterAveragingWorker >();
+    if ( !dist_worker->connect(cmdLineParams.getAsString("-dist-coordinator"), v->size(), c->size(), cmdLineParams.getAsInt("-size")) )
+      return -1;
+    std::cout << "Distributed training: worker " << dist_worker->rank() << " of " << dist_worker->workers_count() << std::endl;
+  }
 
   // создание поставщика обучающих примеров
   // к моменту создания "поставщика обучающих примеров" словарь должен быть загружен (в частности, используется cn_sum())
-  std::shared_ptr< CustomLearningExampleProvider> lep = std::make_shared< OriginalWord2VecLearningExampleProvider > ( cmdLineParams.getAsString("-train"),
-                                                                                                                      cmdLineParams.getAsInt("-threads"),
-                                                                                                                      cmdLineParams.getAsInt("-window"),
-                                                                                                                      cmdLineParams.getAsFloat("-sample"),
-                                                                                                                      v );
+  std::shared_ptr< CustomLearningExampleProvider> lep;
+  // количество слов (для файла пар -- пар), перебираемых за эпоху
+  uint64_t train_words = corpus_words;
+  if (c != v)
+  {
+    std::shared_ptr< PairsFileLearningExampleProvider> pairs_lep = std::make_shared< PairsFileLearningExampleProvider > ( cmdLineParams.getAsString("-train"),
+                                                                                                                        cmdLineParams.getAsInt("-threads"),
+                                                                                                                        cmdLineParams.getAsFloat("-sample"),
+                                                                                                                        v, c );
+    if ( !pairs_lep->is_valid() )
+      return -1;
+    if (dist_worker)
+      pairs_lep->set_shard(dist_worker->rank(), dist_worker->workers_count());
+    train_words = pairs_lep->get_pairs_count();
+    lep = pairs_lep;
+  }
+  else
+  {
+    std::shared_ptr< OriginalWord2VecLearningExampleProvider> text_lep = std::make_shared< OriginalWord2VecLearningExampleProvider > ( cmdLineParams.getAsString("-train"),
+                                                                                                                                     cmdLineParams.getAsInt("-threads"),
+                                                                                                                                     cmdLineParams.getAsInt("-window"),
+                                                                                                                                     cmdLineParams.getAsFloat("-sample"),
+                                                                                                                                     v );
+    text_lep->set_corpus_words(corpus_words);
+    if (dist_worker)
+      text_lep->set_shard(dist_worker->rank(), dist_worker->workers_count());
+    lep = text_lep;
+  }
 
   // создаем объект, организующий обучение
-  SgTrainer_Mikolov trainer( lep, v , v,
+  SgTrainer_Mikolov trainer( lep, v , c,
                        cmdLineParams.getAsInt("-size"),
                        cmdLineParams.getAsInt("-iter"),
                        cmdLineParams.getAsFloat("-alpha"),
                        cmdLineParams.getAsString("-optimization"),
                        cmdLineParams.getAsFloat("-negative"));
 
+  // размещение весовых матриц в памяти и привязка потоков к ядрам
+  MemoryPlacement placement;
+  if ( !placement.parse(cmdLineParams.getAsString("-pin-threads"), cmdLineParams.getAsString("-numa"), cmdLineParams.getAsString("-huge-pages")) )
+  {
+    std::cerr << "Unknown -pin-threads, -numa or -huge-pages value" << std::endl;
+    return -1;
+  }
+  if (cmdLineParams.isDefined("-weights-dir"))
+  {
+    placement.weights_dir = cmdLineParams.getAsString("-weights-dir");
+    placement.resident_rows = std::max(cmdLineParams.getAsInt("-weights-resident-rows"), 0);
+  }
+  trainer.set_memory_placement(placement);
+  WeightsPrecision precision;
+  if ( !parse_weights_precision(cmdLineParams.getAsString("-weights-precision"), precision) )
+  {
+    std::cerr << "Unknown -weights-precision value" << std::endl;
+    return -1;
+  }
+  trainer.set_weights_precision(precision);
+  UpdateRule update_rule = urSgd;
+  if ( !parse_update_rule(cmdLineParams.getAsString("-optimizer"), update_rule) )
+  {
+    std::cerr << "Unknown -optimizer value" << std::endl;
+    return -1;
+  }
+  trainer.set_update_rule(update_rule);
+  trainer.set_hot_rows(std::max(cmdLineParams.getAsInt("-hot-rows"), 0), std::max(cmdLineParams.getAsInt("-hot-rows-flush"), 1));
+  trainer.set_prefetch(std::max(cmdLineParams.getAsInt("-prefetch"), 0));
+  size_t loss_sampling = std::max(cmdLineParams.getAsInt("-loss-sample"), 0);
+  if (cmdLineParams.isDefined("-early-stop") && loss_sampling == 0)
+    loss_sampling = 100;
+  trainer.set_loss_sampling(loss_sampling, cmdLineParams.isDefined("-early-stop") ? cmdLineParams.getAsFloat("-early-stop") : 0);
+
+  // планирование ресурсов (см. capacity_planner.h): расчет потребности в памяти выводится до выделения весовых матриц
+  size_t threads_count = cmdLineParams.getAsInt("-threads");
+  std::unique_ptr< CapacityPlanner > planner;
+  if (dry_run)
+  {
+    planner = std::make_unique< CapacityPlanner >(trainer, threads_count);
+    if ( !planner->print_memory_plan() )
+      return 1;
+    if (cmdLineParams.getAsFloat("-dry-run") <= 0)
+      return 0;
+  }
+
   // инициализация нейросети
-  trainer.init_net();
+  trainer.init_net(threads_count);
+  if (cmdLineParams.isDefined("-restore") && !trainer.restore(cmdLineParams.getAsString("-restore")))
+    return -1;
+  trainer.set_train_words(train_words / (dist_worker ? dist_worker->workers_count() : 1));
+  if (dist_worker)
+    trainer.attach_parameter_averaging(*dist_worker);
+  // калибровочный прогон и оценка времени работы (результат не сохраняется)
+  if (planner)
+  {
+    const double startup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_tp).count();
+    planner->calibrate(cmdLineParams.getAsFloat("-dry-run"));
+    planner->print_time_estimate(startup_seconds, cmdLineParams.isDefined("-backup"),
+                                 cmdLineParams.isDefined("-time-budget") ? cmdLineParams.getAsFloat("-time-budget") : 0);
+    return 0;
+  }
+  if (cmdLineParams.isDefined("-time-budget"))
+    trainer.set_deadline( start_tp + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(cmdLineParams.getAsFloat("-time-budget"))),
+                          cmdLineParams.isDefined("-backup") );
+
+  // оценка качества модели во время обучения (см. snapshot_evaluator.h)
+  std::unique_ptr< SnapshotEvaluator > evaluator;
+  if (cmdLineParams.isDefined("-eval-similarity") || cmdLineParams.isDefined("-eval-analogy"))
+  {
+    evaluator = std::make_unique< SnapshotEvaluator >(trainer, std::max(cmdLineParams.getAsInt("-eval-rows"), 1), cmdLineParams.getAsFloat("-eval-interval"));
+    if (cmdLineParams.isDefined("-eval-similarity") && !evaluator->load_similarity(cmdLineParams.getAsString("-eval-similarity")))
+      return -1;
+    if (cmdLineParams.isDefined("-eval-analogy") && !evaluator->load_analogy(cmdLineParams.getAsString("-eval-analogy")))
+      return -1;
+    if (cmdLineParams.isDefined("-eval-log") && !evaluator->open_log(cmdLineParams.getAsString("-eval-log")))
+      return -1;
+    if (cmdLineParams.isDefined("-eval-abort"))
+      evaluator->set_abort_threshold(cmdLineParams.getAsFloat("-eval-abort"), cmdLineParams.getAsFloat("-eval-abort-after"));
+    evaluator->start();
+  }
+  // экспорт метрик обучения (см. metrics_exporter.h)
+  std::unique_ptr< MetricsExporter > metrics;
+  if (cmdLineParams.isDefined("-metrics-port") || cmdLineParams.isDefined("-metrics-file"))
+  {
+    metrics = std::make_unique< MetricsExporter >(trainer, cmdLineParams.getAsFloat("-metrics-interval"));
+    if (cmdLineParams.isDefined("-metrics-port") && !metrics->listen_on(cmdLineParams.getAsInt("-metrics-port")))
+      return -1;
+    if (cmdLineParams.isDefined("-metrics-file"))
+      metrics->write_to(cmdLineParams.getAsString("-metrics-file"));
+    metrics->start();
+  }
 
   // запускаем потоки, осуществляющие обучение
-  size_t threads_count = cmdLineParams.getAsInt("-threads");
+  if (cmdLineParams.isDefined("-profile"))
+    Profiler::instance().enable(threads_count, (cmdLineParams.getAsString("-profile") == "stdout") ? std::string() : cmdLineParams.getAsString("-profile"));
   std::vector<std::thread> threads_vec;
   threads_vec.reserve(threads_count);
   for (size_t i = 0; i < threads_count; ++i)
     threads_vec.emplace_back(&CustomTrainer::train_entry_point, &trainer, i);
+  // синхронизация весовых матриц с другими процессами распределенного обучения ведется параллельно с обучением
+  std::atomic<bool> training_finished(false);
+  std::thread dist_thread;
+  if (dist_worker)
+    dist_thread = std::thread(&ParameterAveragingWorker::run, dist_worker.get(), cmdLineParams.getAsFloat("-dist-sync-interval"), std::cref(training_finished));
   for (size_t i = 0; i < threads_count; ++i)
     threads_vec[i].join();
+  training_finished = true;
+  if (dist_thread.joinable())
+    dist_thread.join();
+  if (evaluator)
+    evaluator->stop();
+  if (metrics)
+    metrics->stop();
+  Profiler::instance().finish();
+  if (trainer.deadline_reached())
+    std::cout << std::endl << "Time budget is exhausted: training stopped before the end of -iter epochs" << std::endl;
+  if (trainer.early_stopped())
+    std::cout << std::endl << "Training stopped early: the sampled loss no longer improves by -early-stop" << std::endl;
+  // прогон, прерванный по результатам оценки, не сохраняется
+  if (evaluator && evaluator->aborted())
+    return 2;
+
+  // по окончании распределенного обучения модели всех процессов совпадают, результат сохраняет процесс с номером 0
+  if (dist_worker && dist_worker->rank() != 0)
+    return 0;
 
   // сохраняем вычисленные вектора в файл
   trainer.saveEmbeddings( cmdLineParams.getAsString("-output") );
-//  if (cmdLineParams.isDefined("-backup"))
-//    trainer.backup( cmdLineParams.getAsString("-backup") );
+  if (cmdLineParams.isDefined("-backup"))
+    trainer.backup( cmdLineParams.getAsString("-backup") );
 
   return 0;
 }
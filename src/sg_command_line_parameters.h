@@ -11,11 +11,11 @@ public:
     // initialize params mapping with std::initialzer_list<T>
     params_ = {
         {"-words-vocab",  {"The words vocabulary will be read from <file>", std::nullopt, std::nullopt}},
-//        {"-ctx-vocab",    {"The contexts vocabulary will be read from <file>", std::nullopt, std::nullopt}},
+        {"-ctx-vocab",    {"The contexts vocabulary will be read from <file>; -train is then a binary (word, context) pairs file built by build_pairs", std::nullopt, std::nullopt}},
 //        {"-min-count",    {"This will discard words that appear less than <int> times", "5", std::nullopt}},
         {"-train",        {"Use text data from <file> to train the model", std::nullopt, std::nullopt}},
-//        {"-backup",       {"Save neural network weights to <file>", std::nullopt, std::nullopt}},
-//        {"-restore",      {"Restore neural network weights from <file>", std::nullopt, std::nullopt}},
+        {"-backup",       {"Save neural network weights (and vocabulary counts) to <file>", std::nullopt, std::nullopt}},
+        {"-restore",      {"Warm-start from weights saved with -backup; the vocabulary is extended with new words from -words-vocab", std::nullopt, std::nullopt}},
         {"-output",       {"Use <file> to save the resulting word vectors", std::nullopt, std::nullopt}},
         {"-size",         {"Set size of word vectors", "100", std::nullopt}},
         {"-window",       {"Set max skip length between words", "5", std::nullopt}},
@@ -23,8 +23,35 @@ public:
         {"-optimization", {"Optimization method: hierarchical softmax (hs) or negative sampling (ns)", "ns", std::nullopt}},
         {"-negative",     {"Number of negative examples", "5", std::nullopt}},
         {"-alpha",        {"Set the starting learning rate", "0.025", std::nullopt}},
+        {"-optimizer",    {"Weights update rule: sgd or adagrad (sparse AdaGrad: one accumulator per row of each weight matrix, updated only for rows touched by the example; usually needs a 4 times higher -alpha)", "sgd", std::nullopt}},
         {"-iter",         {"Run more training iterations", "5", std::nullopt}},
-        {"-threads",      {"Use <int> threads", "12", std::nullopt}}
+        {"-time-budget",  {"Finish within <float> seconds of wall-clock time (including loading and saving): alpha decays to its minimum by the deadline, -iter becomes the maximum number of epochs", std::nullopt, std::nullopt}},
+        {"-threads",      {"Use <int> threads", "12", std::nullopt}},
+        {"-weights-precision", {"Storage format of weight matrices: fp32, bf16 or fp16 (computations are always done in fp32, output is fp32)", "fp32", std::nullopt}},
+        {"-hot-rows",     {"Number of most frequent rows of each weight matrix that threads update in private copies (0 = plain Hogwild)", "0", std::nullopt}},
+        {"-hot-rows-flush", {"Merge private copies of hot rows into shared weights every <int> learning examples", "1000", std::nullopt}},
+        {"-prefetch",     {"Read <int> learning examples ahead and prefetch their weight rows (and the next negative's row) into cache (0 = off)", "0", std::nullopt}},
+        {"-loss-sample",  {"Track the training loss on every <int>-th learning example and report its mean per epoch (0 = off)", "0", std::nullopt}},
+        {"-early-stop",   {"Stop after the epoch whose sampled loss improved by less than <float> (relative) over the previous one; implies -loss-sample 100 if it is off", std::nullopt, std::nullopt}},
+        {"-dist-coordinator", {"Take part in distributed training: connect to the coordinator at <host>:<port> and train on this worker's shard of the data", std::nullopt, std::nullopt}},
+        {"-dist-sync-interval", {"Average weights with other workers every <float> seconds", "5", std::nullopt}},
+        {"-pin-threads",  {"Pin threads to cores: none, compact (fill NUMA nodes one by one) or scatter (round-robin over NUMA nodes)", "none", std::nullopt}},
+        {"-numa",         {"Weights placement on NUMA hosts: first-touch (parallel initialization) or interleave", "first-touch", std::nullopt}},
+        {"-huge-pages",   {"Back weight matrices with huge pages: none, thp (transparent, madvise) or explicit (MAP_HUGETLB with thp fallback)", "none", std::nullopt}},
+        {"-weights-dir",  {"Back weight matrices with memory-mapped files in <dir> (e.g. on local NVMe) for models larger than RAM", std::nullopt, std::nullopt}},
+        {"-weights-resident-rows", {"With -weights-dir: number of leading (most frequent) rows of each matrix locked in RAM", "100000", std::nullopt}},
+        {"-eval-similarity", {"Evaluate snapshots of the model during training on word similarity pairs from <file> (word1 word2 score per line)", std::nullopt, std::nullopt}},
+        {"-eval-analogy", {"Evaluate snapshots of the model during training on analogy questions from <file> (a b c d per line)", std::nullopt, std::nullopt}},
+        {"-eval-interval", {"Evaluate a snapshot every <float> seconds", "60", std::nullopt}},
+        {"-eval-rows",    {"Number of most frequent words in a snapshot (test items with other words are skipped)", "30000", std::nullopt}},
+        {"-eval-log",     {"Write evaluation scores (the quality curve) to <file> in TSV format", std::nullopt, std::nullopt}},
+        {"-eval-abort",   {"Abort training (exit code 2, nothing is saved) when the mean evaluation score drops below <float> or weights diverge", std::nullopt, std::nullopt}},
+        {"-eval-abort-after", {"Apply -eval-abort only after this share of training is done", "0.1", std::nullopt}},
+        {"-metrics-port", {"Serve training metrics in Prometheus text format at http://127.0.0.1:<int>/metrics", std::nullopt, std::nullopt}},
+        {"-metrics-file", {"Write training metrics in Prometheus text format to <file> (replaced atomically, e.g. for node_exporter textfile collector)", std::nullopt, std::nullopt}},
+        {"-metrics-interval", {"Update exported metrics every <float> seconds", "5", std::nullopt}},
+        {"-dry-run",      {"Print the memory plan and, if <float> > 0, calibrate throughput for <float> seconds and estimate the wall time; nothing is saved", std::nullopt, std::nullopt}},
+        {"-profile",      {"Collect per-thread profile (summary on exit or SIGUSR1); 'stdout' or <file> to also save it as JSON", std::nullopt, std::nullopt}}
     };
   }
 };
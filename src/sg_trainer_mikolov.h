@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <functional>
 #include <numeric>
+#include <type_traits>
 //#include <execution>
 
 #include "trainer.h"
@@ -23,84 +24,161 @@ public:
                      size_t negative_count = 5 )
   : CustomTrainer(learning_example_provider, words_vocabulary, contexts_vocabulary, words_vocabulary, contexts_vocabulary, embedding_size, epochs, learning_rate, optimization, negative_count)
   {
+    // отрицательные примеры выбираются из словаря контекстов (при общем словаре он совпадает со словарем слов)
     if (optimization_algo == loaNegativeSampling)
-      InitUnigramTable_w();
+      InitUnigramTable_c();
   }
   // деструктор
   virtual ~SgTrainer_Mikolov()
   {
   }
   // функция, реализующая модель обучения skip-gram
-  void learning_model(const LearningExample& le, float *neu1, float *neu1e)
+  void learning_model(const LearningExample& le, float *neu1, float *neu1e, HotRows& hot_rows, LossAccumulator *loss)
+  {
+    switch (precision)
+    {
+      case wpFloat32:  learning_model_impl(le, neu1, neu1e, hot_rows, syn0, syn1, loss); break;
+      case wpBFloat16: learning_model_impl(le, neu1, neu1e, hot_rows, reinterpret_cast<bf16_t*>(syn0), reinterpret_cast<bf16_t*>(syn1), loss); break;
+      case wpFloat16:  learning_model_impl(le, neu1, neu1e, hot_rows, reinterpret_cast<fp16_t*>(syn0), reinterpret_cast<fp16_t*>(syn1), loss); break;
+    }
+  } // method-end
+  // упреждающая загрузка в кэш строк, нужных для обработки обучающего примера: входных векторов и выходных строк (узлов путей)
+  void prefetch_example(const LearningExample& le)
+  {
+    const bool predict_contexts = (w_vocabulary != c_vocabulary);
+    if (predict_contexts)
+      prefetch_matrix_row(syn0, le.word);
+    for (auto&& ctx_idx : le.context)
+    {
+      if (!predict_contexts)
+        prefetch_matrix_row(syn0, ctx_idx);
+      else if (optimization_algo == loaHierarchicalSoftmax)
+        prefetch_huffman_path(ctx_idx);
+      else
+        prefetch_matrix_row(syn1, ctx_idx);
+    }
+    if (!predict_contexts)
+    {
+      if (optimization_algo == loaHierarchicalSoftmax)
+        prefetch_huffman_path(le.word);
+      else
+        prefetch_matrix_row(syn1, le.word);
+    }
+  }
+private:
+  // модель обучения skip-gram для заданного формата хранения весов T
+  template <typename T>
+  void learning_model_impl(const LearningExample& le, float *neu1, float *neu1e, HotRows& hot_rows, T *w0, T *w1, LossAccumulator *loss)
   {
     if (le.context.size() == 0) return;
+    // при общем словаре (оригинальный word2vec) на вход подается контекст и предсказывается слово;
+    // при отдельном словаре контекстов на вход подается слово (его вектор и есть результат обучения) и предсказывается контекст
+    const bool predict_contexts = (w_vocabulary != c_vocabulary);
+    // при AdaGrad g -- градиент без коэффициента скорости обучения, а шаг каждой строки вычисляется по её накопителю
+    const bool adagrad = (update_rule == urAdaGrad);
+    const float g_scale = gradient_scale();
     // цикл по контекстам
     for (auto&& ctx_idx : le.context)
     {
+      const word_index_t input_idx = predict_contexts ? le.word : ctx_idx;
+      const word_index_t output_idx = predict_contexts ? ctx_idx : le.word;
       // зануляем текущие значения ошибок (это частная производная ошибки E по выходу скрытого слоя h)
       std::fill(neu1e, neu1e+layer1_size, 0.0);
       // вычисляем смещение вектора, соответствующего очередному контексту
-      float *ctxVectorPtr = syn0 + ctx_idx * layer1_size;
+      T *ctxRowPtr = hot_rows.in.row(w0, input_idx);
+      // выход скрытого слоя (в skip-gram он совпадает с вектором контекста);
+      // при хранении весов с пониженной точностью вектор контекста предварительно преобразуется во float (neu1 в skip-gram не используется)
+      const float *ctxVectorPtr = nullptr;
+      if constexpr (std::is_same_v<T, float>)
+        ctxVectorPtr = ctxRowPtr;
+      else
+      {
+        load_row(neu1, ctxRowPtr, layer1_size);
+        ctxVectorPtr = neu1;
+      }
+      const float ctx_sq = adagrad ? dot_row(ctxVectorPtr, ctxVectorPtr, layer1_size) : 0;
       if (optimization_algo == loaHierarchicalSoftmax)  // hierarchical softmax
       {
-        auto&& current_word_data = in_vocabulary->idx_to_data(le.word);
+        auto&& current_word_data = out_vocabulary->idx_to_data(output_idx);
         const size_t huffman_code_len = current_word_data.huffman_code_float.size();
         for (size_t d = 0; d < huffman_code_len; ++d)
         {
+          profile_section(psComputeForward);
           // вычисляем смещение вектора, соответствующего очередному узлу в дереве Хаффмана
-          float *nodeVectorPtr = syn1 + current_word_data.huffman_path[d] * layer1_size;
+          T *nodeVectorPtr = hot_rows.out.row(w1, current_word_data.huffman_path[d]);
           // вычисляем выход соответствующего нейрона выходного слоя (hidden -> output)
           // он вычисляется как сигма-функция от скалярного произведения векторов: весового вектора, соответствующего текущему узлу в дереве Хаффмана, и вектора, соответствующего выходу скрытого слоя
           // в skip-gram выход скрытого слоя в точности соответствует вектору контекста
           //float f = std::transform_reduce(std::execution::par, ctxVectorPtr, ctxVectorPtr+layer1_size, nodeVectorPtr, 0.0, std::plus<>(), std::multiplies<>());
-          float f = std::inner_product(ctxVectorPtr, ctxVectorPtr+layer1_size, nodeVectorPtr, 0.0);
+          float f = dot_row(ctxVectorPtr, nodeVectorPtr, layer1_size);
+          profile_count(pcDots);
+          if (loss)
+          {
+            loss->sum += logistic_loss(f, current_word_data.huffman_code_float[d] == 0);
+            ++loss->count;
+          }
           if (f <= -MAX_EXP || f >= MAX_EXP) continue;
           else f = expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
           // 'g' is the gradient multiplied by the learning rate
-          float g = (1.0 - current_word_data.huffman_code_float[d] - f) * alpha;
+          float g = (1.0 - current_word_data.huffman_code_float[d] - f) * g_scale;
+          profile_section(psComputeBackward);
           // Propagate errors output -> hidden
-          std::transform(neu1e, neu1e+layer1_size, nodeVectorPtr, neu1e, [g](float a, float b) -> float {return a + g*b;});
+          axpy_row(neu1e, g, nodeVectorPtr, layer1_size);
           // Learn weights hidden -> output
-          std::transform(nodeVectorPtr, nodeVectorPtr+layer1_size, ctxVectorPtr, nodeVectorPtr, [g](float a, float b) -> float {return a + g*b;});
+          update_row(nodeVectorPtr, adagrad ? g * adagrad_rate(adagrad_syn1, current_word_data.huffman_path[d], g * g * ctx_sq) : g, ctxVectorPtr, layer1_size);
         }
       }
       else if (optimization_algo == loaNegativeSampling) // negative sampling
       {
-        size_t target;
+        word_index_t target;
         int label; // знаковое целое (!)
         float g = 0;
+        // отрицательный пример выбирается на шаг раньше его обработки (см. cbow_trainer_mikolov.h)
+        word_index_t next_negative = (negative > 0) ? draw_negative(out_vocabulary->size()) : 0;
         for (size_t d = 0; d <= negative; ++d)
         {
+          profile_section(psComputeForward);
           if (d == 0) // на первой итерации рассматриваем положительный пример (слово, предсказываемое по контексту)
           {
-            target = le.word;
+            target = output_idx;
             label = 1;
           }
           else // на остальных итерациях рассматриваем отрицательные примеры (случайные слова из noise distribution)
           {
-            next_random_ns = next_random_ns * (unsigned long long)25214903917 + 11;
-            target = table[(next_random_ns >> 16) % table_size];
-            if (target == 0) target = next_random_ns % (in_vocabulary->size() - 1) + 1;
-            if (target == le.word) continue;
+            target = next_negative;
+            if (d < negative)
+              next_negative = draw_negative(out_vocabulary->size());
+            if (target == output_idx) continue;
             label = 0;
           }
           // вычисляем смещение вектора, соответствующего очередному положительному/отрицательному примеру
-          float *targetVectorPtr = syn1 + target * layer1_size;
+          T *targetVectorPtr = hot_rows.out.row(w1, target);
           // в skip-gram выход скрытого слоя в точности соответствует вектору контекста
           // вычисляем выход нейрона выходного слоя (нейрона, соответствующего рассматриваемому положительному/отрицательному примеру) (hidden -> output)
-          float f = std::inner_product(ctxVectorPtr, ctxVectorPtr+layer1_size, targetVectorPtr, 0.0);
+          float f = dot_row(ctxVectorPtr, targetVectorPtr, layer1_size);
+          profile_count(pcDots);
+          if (loss)
+          {
+            loss->sum += logistic_loss(f, label);
+            ++loss->count;
+          }
           // вычислим градиент умноженный на коэффициент скорости обучения
-          if (f > MAX_EXP) g = (label - 1) * alpha;
-          else if (f < -MAX_EXP) g = (label - 0) * alpha;
-          else g = (label - expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))]) * alpha;
+          if (f > MAX_EXP) g = (label - 1) * g_scale;
+          else if (f < -MAX_EXP) g = (label - 0) * g_scale;
+          else g = (label - expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))]) * g_scale;
+          profile_section(psComputeBackward);
           // Propagate errors output -> hidden
-          std::transform(neu1e, neu1e+layer1_size, targetVectorPtr, neu1e, [g](float a, float b) -> float {return a + g*b;});
+          axpy_row(neu1e, g, targetVectorPtr, layer1_size);
           // Learn weights hidden -> output
-          std::transform(targetVectorPtr, targetVectorPtr+layer1_size, ctxVectorPtr, targetVectorPtr, [g](float a, float b) -> float {return a + g*b;});
+          update_row(targetVectorPtr, adagrad ? g * adagrad_rate(adagrad_syn1, target, g * g * ctx_sq) : g, ctxVectorPtr, layer1_size);
         } // for all samples
       } // if (optimization_algo == ???) ... else ...
       // Learn weights input -> hidden
-      std::transform(ctxVectorPtr, ctxVectorPtr+layer1_size, neu1e, ctxVectorPtr, std::plus<float>());
+      profile_section(psComputeBackward);
+      if (adagrad)
+        update_row(ctxRowPtr, adagrad_rate(adagrad_syn0, input_idx, dot_row(neu1e, neu1e, layer1_size)), neu1e, layer1_size);
+      else
+        add_to_row(ctxRowPtr, neu1e, layer1_size);
     } // for all contexts
   } // method-end
 };
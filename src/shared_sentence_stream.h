@@ -0,0 +1,213 @@
+#ifndef SHARED_SENTENCE_STREAM_H_
+#define SHARED_SENTENCE_STREAM_H_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <optional>
+#include "learning_example_provider.h"
+#include "original_word2vec_le_provider.h"
+
+
+// Общий для нескольких моделей поток предложений.
+// При одновременном обучении нескольких моделей (утилита sweep) обучающее множество читается, токенизируется и прореживается
+// однократно: часть t обучающего множества (как и в OriginalWord2VecLearningExampleProvider, по числу потоков) читается
+// порциями предложений, и каждую порцию получают потоки с номером t всех моделей. Порцию читает тот поток, которому она
+// понадобилась первой; порция освобождается, когда её получили все модели. Количество хранимых порций ограничено,
+// поэтому модели, опередившие самую медленную, ожидают её.
+
+
+// порция предложений одной части обучающего множества
+struct SentenceBatch
+{
+  std::vector< std::vector<word_index_t> > sentences;
+  uint64_t words_count = 0;   // количество слов, прочитанных в текущей эпохе к концу порции (без учета сабсэмплинга)
+  bool epoch_end = false;     // порция завершает эпоху
+};
+
+
+class SharedSentenceStream
+{
+public:
+  // конструктор; reader -- поставщик обучающих примеров, используемый только для чтения предложений (get_sentence)
+  SharedSentenceStream(std::shared_ptr< OriginalWord2VecLearningExampleProvider > reader, size_t partsCount, size_t modelsCount, size_t epochsCount)
+  : sentence_reader(reader)
+  , models_count(modelsCount)
+  , epochs_count(epochsCount)
+  , parts(partsCount)
+  {
+    for (auto&& part : parts)
+      part.consumer_pos.assign(models_count, 0);
+  }
+  // получение моделью model_idx очередной порции части part_idx (при необходимости порция читается вызывающим потоком)
+  std::shared_ptr<const SentenceBatch> next_batch(size_t model_idx, size_t part_idx)
+  {
+    auto& part = parts[part_idx];
+    std::unique_lock<std::mutex> lock(part.mtx);
+    const uint64_t wanted = part.consumer_pos[model_idx];
+    while (wanted >= part.first_index + part.batches.size())
+    {
+      if (!part.producing && part.batches.size() < MAX_BATCHES && part.epochs_done < epochs_count)
+      {
+        part.producing = true;
+        lock.unlock();
+        auto batch = read_batch(part_idx, part);
+        lock.lock();
+        part.batches.push_back(batch);
+        part.producing = false;
+        part.cv.notify_all();
+      }
+      else
+        part.cv.wait(lock);
+    }
+    auto result = part.batches[wanted - part.first_index];
+    ++part.consumer_pos[model_idx];
+    // освобождаем порции, полученные всеми моделями
+    const uint64_t slowest = *std::min_element(part.consumer_pos.begin(), part.consumer_pos.end());
+    bool released = false;
+    while (part.first_index < slowest)
+    {
+      part.batches.pop_front();
+      ++part.first_index;
+      released = true;
+    }
+    if (released)
+      part.cv.notify_all();
+    return result;
+  } // method-end
+private:
+  // максимальное количество хранимых порций одной части и количество слов в порции
+  static const size_t MAX_BATCHES = 16;
+  static const size_t BATCH_WORDS = 16384;
+  struct Part
+  {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque< std::shared_ptr<const SentenceBatch> > batches;
+    uint64_t first_index = 0;              // номер первой хранимой порции
+    std::vector<uint64_t> consumer_pos;    // номер следующей порции для каждой модели
+    bool producing = false;                // порция читается одним из потоков
+    bool epoch_open = false;               // эпоха начата (epoch_prepare выполнен)
+    size_t epochs_done = 0;                // количество прочитанных эпох
+  };
+  std::shared_ptr< OriginalWord2VecLearningExampleProvider > sentence_reader;
+  size_t models_count;
+  size_t epochs_count;
+  std::vector<Part> parts;
+
+  // чтение порции предложений (вне блокировки; часть в каждый момент читает лишь один поток)
+  std::shared_ptr<const SentenceBatch> read_batch(size_t part_idx, Part& part)
+  {
+    auto batch = std::make_shared<SentenceBatch>();
+    if (!part.epoch_open)
+      part.epoch_open = sentence_reader->epoch_prepare(part_idx);
+    size_t words = 0;
+    std::vector<word_index_t> sentence;
+    while (part.epoch_open && words < BATCH_WORDS)
+    {
+      if ( !sentence_reader->get_sentence(part_idx, sentence) )
+      {
+        sentence_reader->epoch_unprepare(part_idx);
+        part.epoch_open = false;
+        batch->epoch_end = true;
+        break;
+      }
+      words += sentence.size();
+      batch->sentences.emplace_back(std::move(sentence));
+      sentence.clear();
+    }
+    // часть, которую не удалось открыть, завершает эпоху пустой порцией
+    if (!part.epoch_open)
+    {
+      batch->epoch_end = true;
+      ++part.epochs_done;
+    }
+    batch->words_count = sentence_reader->getWordsCount(part_idx);
+    return batch;
+  } // method-end
+}; // class-decl-end
+
+
+// Поставщик обучающих примеров одной модели, формирующий их из общего потока предложений
+// (контекстное окно выбирается функцией make_window_example, но со своим размером и генератором случайных чисел)
+class SharedStreamLearningExampleProvider : public CustomLearningExampleProvider
+{
+public:
+  // конструктор
+  SharedStreamLearningExampleProvider(std::shared_ptr<SharedSentenceStream> sentence_stream, size_t modelIndex, size_t threadsCount, size_t ctxWindow)
+  : CustomLearningExampleProvider(threadsCount)
+  , stream(sentence_stream)
+  , model_idx(modelIndex)
+  , window(ctxWindow)
+  {
+    thread_environment.resize(threads_count);
+    for (size_t i = 0; i < threads_count; ++i)
+      thread_environment[i].next_random = i;
+  }
+  // деструктор
+  virtual ~SharedStreamLearningExampleProvider()
+  {
+  }
+  // подготовительные действия, выполняемые перед каждой эпохой обучения
+  bool epoch_prepare(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    t_environment.batch.reset();
+    t_environment.sentence_idx = 0;
+    t_environment.position_in_sentence = 0;
+    t_environment.words_count = 0;
+    return true;
+  }
+  // заключительные действия, выполняемые после каждой эпохи обучения
+  bool epoch_unprepare(size_t threadIndex)
+  {
+    thread_environment[threadIndex].batch.reset();
+    return true;
+  }
+  // получение очередного обучающего примера
+  std::optional<LearningExample> get(size_t threadIndex)
+  {
+    auto& t_environment = thread_environment[threadIndex];
+    while ( !t_environment.batch || t_environment.sentence_idx == t_environment.batch->sentences.size() )
+    {
+      if ( t_environment.batch && t_environment.batch->epoch_end )  // это признак конца эпохи
+        return std::nullopt;
+      t_environment.batch = stream->next_batch(model_idx, threadIndex);
+      t_environment.sentence_idx = 0;
+      t_environment.position_in_sentence = 0;
+      t_environment.words_count = t_environment.batch->words_count;
+    }
+    auto&& sentence = t_environment.batch->sentences[t_environment.sentence_idx];
+    LearningExample result = make_window_example(sentence, t_environment.position_in_sentence, window, t_environment.next_random);
+    if ( ++t_environment.position_in_sentence == static_cast<int>(sentence.size()) )
+    {
+      ++t_environment.sentence_idx;
+      t_environment.position_in_sentence = 0;
+    }
+    return result;
+  } // method-end
+  // получение количества слов, фактически считанных из обучающего множества (т.е. без учета сабсэмплинга)
+  uint64_t getWordsCount(size_t threadIndex) const
+  {
+    return thread_environment[threadIndex].words_count;
+  }
+private:
+  struct ThreadEnvironment
+  {
+    std::shared_ptr<const SentenceBatch> batch;   // текущая порция предложений
+    size_t sentence_idx = 0;                      // текущее предложение порции
+    int position_in_sentence = 0;                 // текущая позиция в предложении
+    unsigned long long next_random = 0;           // поле для вычисления случайных величин
+    uint64_t words_count = 0;                     // количество прочитанных слов в текущей эпохе
+  };
+  std::vector<ThreadEnvironment> thread_environment;
+  std::shared_ptr<SharedSentenceStream> stream;
+  size_t model_idx;
+  size_t window;
+}; // class-decl-end
+
+
+#endif /* SHARED_SENTENCE_STREAM_H_ */
@@ -0,0 +1,348 @@
+#ifndef SNAPSHOT_EVALUATOR_H_
+#define SNAPSHOT_EVALUATOR_H_
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "trainer.h"
+#include "vocabulary.h"
+
+
+// Оценка качества модели во время обучения.
+// Отдельный поток управления раз в interval секунд снимает копию первых rows строк матрицы эмбеддингов (самых частотных слов;
+// копирование строк занимает доли секунды и не останавливает обучение) и оценивает её на тестовых наборах:
+//   - близости слов (строки "слово1 слово2 оценка"): коэффициент ранговой корреляции Спирмена между косинусной мерой и оценкой;
+//   - аналогий (строки "a b c d", строки с ':' в начале -- заголовки разделов): доля вопросов, для которых ближайшим к b - a + c
+//     (3CosAdd, среди первых rows слов, кроме a, b, c) оказывается слово d; оценивается не более MAX_ANALOGY_QUESTIONS вопросов,
+//     равномерно выбранных из набора.
+// Используются лишь элементы наборов, все слова которых входят в первые rows слов словаря. Оценки выводятся в консоль и (кривая
+// качества) в журнал формата TSV. Если задан порог, то после прохождения заданной доли обучения прогон, средняя оценка которого
+// ниже порога (либо веса которого разошлись -- стали бесконечными или NaN), прерывается.
+
+
+class SnapshotEvaluator
+{
+public:
+  // конструктор
+  SnapshotEvaluator(CustomTrainer& observed_trainer, size_t snapshot_rows, double interval_seconds)
+  : trainer(observed_trainer)
+  , vocabulary(observed_trainer.embeddings_vocabulary())
+  , rows( std::min(snapshot_rows, vocabulary.size()) )
+  , interval( std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(interval_seconds, 1.0))) )
+  {
+  }
+  SnapshotEvaluator(const SnapshotEvaluator&) = delete;
+  SnapshotEvaluator& operator=(const SnapshotEvaluator&) = delete;
+  ~SnapshotEvaluator()
+  {
+    stop();
+  }
+  // загрузка тестового набора близости слов
+  bool load_similarity(const std::string& filename)
+  {
+    std::ifstream ifs(filename);
+    if ( !ifs.good() )
+    {
+      std::cerr << "Can't open similarity test set: " << filename << std::endl;
+      return false;
+    }
+    std::string line, w1, w2;
+    size_t total = 0;
+    while ( std::getline(ifs, line) )
+    {
+      if (line.empty() || line[0] == '#') continue;
+      std::istringstream iss(line);
+      float score = 0;
+      if ( !(iss >> w1 >> w2 >> score) ) continue;
+      ++total;
+      const word_index_t i1 = lookup(w1), i2 = lookup(w2);
+      if (i1 != NO_WORD_INDEX && i2 != NO_WORD_INDEX)
+        similarity.push_back( {i1, i2, score} );
+    }
+    std::cout << "Similarity test set: " << similarity.size() << " of " << total << " pairs within the first " << rows << " words" << std::endl;
+    if (similarity.size() < 2)
+    {
+      std::cerr << "Too few similarity pairs to evaluate: " << filename << std::endl;
+      return false;
+    }
+    return true;
+  } // method-end
+  // загрузка тестового набора аналогий
+  bool load_analogy(const std::string& filename)
+  {
+    std::ifstream ifs(filename);
+    if ( !ifs.good() )
+    {
+      std::cerr << "Can't open analogy test set: " << filename << std::endl;
+      return false;
+    }
+    std::string line, w[4];
+    std::vector<AnalogyQuestion> all;
+    size_t total = 0;
+    while ( std::getline(ifs, line) )
+    {
+      if (line.empty() || line[0] == ':' || line[0] == '#') continue;
+      std::istringstream iss(line);
+      if ( !(iss >> w[0] >> w[1] >> w[2] >> w[3]) ) continue;
+      ++total;
+      AnalogyQuestion q;
+      bool known = true;
+      for (size_t i = 0; i < 4; ++i)
+        known = known && ((q.idx[i] = lookup(w[i])) != NO_WORD_INDEX);
+      if (known)
+        all.push_back(q);
+    }
+    // равномерная выборка вопросов (оценка каждого вопроса требует просмотра всех строк снимка)
+    const size_t selected = std::min(all.size(), MAX_ANALOGY_QUESTIONS);
+    for (size_t i = 0; i < selected; ++i)
+      analogy.push_back( all[i * all.size() / selected] );
+    std::cout << "Analogy test set: " << all.size() << " of " << total << " questions within the first " << rows << " words, "
+              << analogy.size() << " are evaluated" << std::endl;
+    if (analogy.empty())
+    {
+      std::cerr << "No analogy questions to evaluate: " << filename << std::endl;
+      return false;
+    }
+    return true;
+  } // method-end
+  // открытие журнала оценок (кривой качества)
+  bool open_log(const std::string& filename)
+  {
+    log.open(filename);
+    if ( !log.good() )
+    {
+      std::cerr << "Can't create evaluation log: " << filename << std::endl;
+      return false;
+    }
+    log << "seconds\tprogress\twords\tsimilarity\tanalogy" << std::endl;
+    return true;
+  }
+  // задание порога средней оценки, ниже которого обучение прерывается (после прохождения доли обучения after_progress)
+  void set_abort_threshold(float threshold, float after_progress)
+  {
+    abort_threshold = threshold;
+    abort_after_progress = after_progress;
+    has_abort_threshold = true;
+  }
+  // запуск потока оценки (после init_net)
+  void start()
+  {
+    stopping = false;
+    worker = std::thread(&SnapshotEvaluator::run, this);
+  }
+  // останов потока оценки; если обучение не было прервано, модель оценивается еще раз (окончательная оценка)
+  void stop()
+  {
+    if (!worker.joinable()) return;
+    stopping = true;
+    worker.join();
+  }
+  // обучение было прервано по результатам оценки
+  bool aborted() const
+  {
+    return aborted_flag.load();
+  }
+  // однократная оценка на наборе аналогий без потока оценки (например, по окончании обучения); NaN, если веса разошлись
+  float analogy_score()
+  {
+    if ( !take_snapshot() ) return NAN;
+    return analogy.empty() ? NAN : analogy_accuracy();
+  }
+private:
+  // максимальное количество оцениваемых вопросов на аналогии
+  static const size_t MAX_ANALOGY_QUESTIONS = 1000;
+  // интервал проверки признака останова
+  static constexpr int STOP_POLL_MS = 200;
+  struct SimilarityPair
+  {
+    word_index_t w1, w2;
+    float score;
+  };
+  struct AnalogyQuestion
+  {
+    word_index_t idx[4];
+  };
+  CustomTrainer& trainer;
+  const CustomVocabulary& vocabulary;
+  size_t rows;
+  std::chrono::steady_clock::duration interval;
+  std::vector<SimilarityPair> similarity;
+  std::vector<AnalogyQuestion> analogy;
+  std::ofstream log;
+  bool has_abort_threshold = false;
+  float abort_threshold = 0;
+  float abort_after_progress = 0;
+  std::thread worker;
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> aborted_flag{false};
+  // снимок матрицы эмбеддингов (нормированные строки)
+  std::vector<float> snapshot;
+
+  // индекс слова, если оно входит в первые rows слов словаря, иначе NO_WORD_INDEX
+  word_index_t lookup(const std::string& word) const
+  {
+    const word_index_t idx = vocabulary.word_to_idx(word);
+    return (idx != NO_WORD_INDEX && idx < rows) ? idx : NO_WORD_INDEX;
+  }
+  // рабочий цикл потока оценки
+  void run()
+  {
+    std::chrono::steady_clock::time_point next_eval_tp = std::chrono::steady_clock::now() + interval;
+    while ( !stopping.load() )
+    {
+      if (std::chrono::steady_clock::now() < next_eval_tp)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(STOP_POLL_MS));
+        continue;
+      }
+      if ( !evaluate(false) ) return;
+      next_eval_tp = std::chrono::steady_clock::now() + interval;
+    }
+    evaluate(true);
+  } // method-end
+  // снятие снимка и нормирование его строк; false, если веса разошлись (стали бесконечными или NaN)
+  bool take_snapshot()
+  {
+    trainer.snapshot_embeddings(rows, snapshot);
+    const size_t dim = trainer.embedding_size();
+    bool diverged = false;
+    for (size_t a = 0; a < rows; ++a)
+    {
+      float *row = snapshot.data() + a * dim;
+      const double len = std::sqrt( std::inner_product(row, row + dim, row, 0.0) );
+      if ( !std::isfinite(len) ) diverged = true;
+      if (len > 0)
+        std::transform(row, row + dim, row, [len](float v) -> float {return v / len;});
+    }
+    return !diverged;
+  } // method-end
+  // снятие и оценка снимка; false -- обучение прервано
+  bool evaluate(bool final_evaluation)
+  {
+    const CustomTrainer::Status status = trainer.status();
+    const bool diverged = !take_snapshot();
+    const float sim_score = similarity.empty() ? NAN : similarity_score();
+    const float analogy_score = analogy.empty() ? NAN : analogy_accuracy();
+    float mean = 0;
+    size_t scores = 0;
+    for (float score : {sim_score, analogy_score})
+      if ( !std::isnan(score) )
+      {
+        mean += score;
+        ++scores;
+      }
+    mean = (scores > 0) ? mean / scores : NAN;
+    uint64_t words = 0;
+    for (auto w : status.thread_words)
+      words += w;
+    // вывод оценки (отдельной строкой, не затирая строку прогресса) и запись в журнал
+    std::ostringstream msg;
+    msg.setf(std::ios::fixed);
+    msg.precision(4);
+    msg << (final_evaluation ? "Final evaluation" : "Evaluation") << " at " << std::setprecision(1) << status.elapsed_seconds << "s (progress "
+        << status.progress * 100 << "%):" << std::setprecision(4);
+    if ( !similarity.empty() ) msg << " similarity " << sim_score << " (" << similarity.size() << " pairs)";
+    if ( !analogy.empty() ) msg << " analogy " << analogy_score << " (" << analogy.size() << " questions)";
+    if (diverged) msg << " -- weights have diverged";
+    std::cout << std::endl << msg.str() << std::endl;
+    if ( log.is_open() )
+    {
+      log << status.elapsed_seconds << "\t" << status.progress << "\t" << words << "\t";
+      if ( similarity.empty() ) log << "-"; else log << sim_score;
+      log << "\t";
+      if ( analogy.empty() ) log << "-"; else log << analogy_score;
+      log << std::endl;
+    }
+    if ( final_evaluation || !has_abort_threshold || status.progress < abort_after_progress )
+      return true;
+    if ( diverged || std::isnan(mean) || mean < abort_threshold )
+    {
+      std::cout << "Evaluation score is below -eval-abort (" << abort_threshold << "): training is aborted" << std::endl;
+      aborted_flag = true;
+      trainer.request_stop();
+      return false;
+    }
+    return true;
+  } // method-end
+  // коэффициент ранговой корреляции Спирмена между косинусной мерой близости и оценками набора
+  float similarity_score() const
+  {
+    const size_t dim = trainer.embedding_size();
+    std::vector<float> predicted, gold;
+    for (auto&& p : similarity)
+    {
+      const float *v1 = snapshot.data() + p.w1 * dim, *v2 = snapshot.data() + p.w2 * dim;
+      predicted.push_back( std::inner_product(v1, v1 + dim, v2, 0.0f) );
+      gold.push_back( p.score );
+    }
+    const std::vector<double> r1 = ranks(predicted), r2 = ranks(gold);
+    const double n = r1.size(), mean = (n + 1) / 2;
+    double cov = 0, var1 = 0, var2 = 0;
+    for (size_t i = 0; i < r1.size(); ++i)
+    {
+      cov += (r1[i] - mean) * (r2[i] - mean);
+      var1 += (r1[i] - mean) * (r1[i] - mean);
+      var2 += (r2[i] - mean) * (r2[i] - mean);
+    }
+    return (var1 > 0 && var2 > 0) ? cov / std::sqrt(var1 * var2) : 0;
+  } // method-end
+  // ранги значений (с 1; равным значениям -- средний ранг); NaN считается наименьшим значением
+  static std::vector<double> ranks(const std::vector<float>& values)
+  {
+    std::vector<size_t> order(values.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto key = [&values](size_t i) -> float {return std::isnan(values[i]) ? -INFINITY : values[i];};
+    std::sort(order.begin(), order.end(), [&key](size_t a, size_t b) {return key(a) < key(b);});
+    std::vector<double> result(values.size());
+    for (size_t i = 0; i < order.size(); )
+    {
+      size_t j = i;
+      while (j < order.size() && key(order[j]) == key(order[i])) ++j;
+      for (size_t k = i; k < j; ++k)
+        result[order[k]] = (i + j + 1) / 2.0;
+      i = j;
+    }
+    return result;
+  } // method-end
+  // доля правильно решенных аналогий (3CosAdd)
+  float analogy_accuracy() const
+  {
+    const size_t dim = trainer.embedding_size();
+    std::vector<float> target(dim);
+    size_t correct = 0;
+    for (auto&& q : analogy)
+    {
+      const float *a = snapshot.data() + q.idx[0] * dim, *b = snapshot.data() + q.idx[1] * dim, *c = snapshot.data() + q.idx[2] * dim;
+      for (size_t e = 0; e < dim; ++e)
+        target[e] = b[e] - a[e] + c[e];
+      float best_score = -INFINITY;
+      size_t best = rows;
+      for (size_t w = 0; w < rows; ++w)
+      {
+        if (w == q.idx[0] || w == q.idx[1] || w == q.idx[2]) continue;
+        const float *row = snapshot.data() + w * dim;
+        const float score = std::inner_product(row, row + dim, target.data(), 0.0f);
+        if (score > best_score)
+        {
+          best_score = score;
+          best = w;
+        }
+      }
+      if (best == q.idx[3]) ++correct;
+    }
+    return static_cast<float>(correct) / analogy.size();
+  } // method-end
+}; // class-decl-end
+
+
+#endif /* SNAPSHOT_EVALUATOR_H_ */
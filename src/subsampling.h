@@ -0,0 +1,54 @@
+#ifndef SUBSAMPLING_H_
+#define SUBSAMPLING_H_
+
+#include <vector>
+#include <cstdint>
+#include <math.h>
+#include "vocabulary.h"
+
+
+// Таблица порогов прореживания (subsampling) частотных слов.
+// В оригинальном word2vec вероятность сохранения слова вычисляется (с извлечением корня и делением) для каждого прочитанного слова
+// в каждой эпохе, хотя зависит только от частоты слова. Здесь она вычисляется однократно для каждого слова словаря и хранится
+// в виде целочисленного порога, с которым сравниваются младшие 16 бит генератора случайных чисел потока. Порог рассчитан так,
+// что решение в точности совпадает с решением исходной формулы: слово отбрасывается, если ran < (next_random & 0xFFFF) / 65536.
+class SubsamplingTable
+{
+public:
+  // построение таблицы для словаря; sample -- коэффициент прореживания (0 -- прореживание выключено),
+  // train_words -- количество слов в обучающем множестве
+  void build(const CustomVocabulary& vocabulary, float sample, uint64_t train_words)
+  {
+    thresholds.clear();
+    if (sample <= 0) return;
+    thresholds.resize(vocabulary.size());
+    for (size_t idx = 0; idx < vocabulary.size(); ++idx)
+    {
+      auto&& dict_word = vocabulary.idx_to_data(idx);
+      float ran = (sqrt(dict_word.cn / (sample * train_words)) + 1) * (sample * train_words) / dict_word.cn;
+      // ran < r / 65536  <=>  r > ran * 65536 (умножение на степень двойки выполняется точно); порог -- наименьшее такое r
+      const float scaled = ran * 65536;
+      thresholds[idx] = (scaled >= 0 && scaled < 65536) ? static_cast<uint32_t>(scaled) + 1 : (scaled < 0 ? 0 : 65536);
+    }
+  }
+  bool enabled() const
+  {
+    return !thresholds.empty();
+  }
+  // объем памяти, занимаемой таблицей
+  uint64_t memory_bytes() const
+  {
+    return heap_block_bytes(thresholds.capacity() * sizeof(uint32_t));
+  }
+  // следует ли отбросить слово с индексом idx при данном состоянии генератора случайных чисел
+  inline bool discard(word_index_t idx, unsigned long long next_random) const
+  {
+    return (next_random & 0xFFFF) >= thresholds[idx];
+  }
+private:
+  // наименьшее значение 16-битной случайной величины, при котором слово отбрасывается (65536 -- слово никогда не отбрасывается)
+  std::vector<uint32_t> thresholds;
+}; // class-decl-end
+
+
+#endif /* SUBSAMPLING_H_ */
@@ -0,0 +1,122 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include "profiler.h"
+#include "sweep_command_line_parameters.h"
+#include "original_word2vec_vocabulary.h"
+#include "original_word2vec_le_provider.h"
+#include "shared_sentence_stream.h"
+#include "cbow_trainer_mikolov.h"
+#include "sg_trainer_mikolov.h"
+
+
+// Одновременное обучение нескольких моделей (cbow и/или skip-gram с разными параметрами) за один проход по обучающему множеству.
+// Обучающее множество читается, токенизируется и прореживается однократно (см. shared_sentence_stream.h), у каждой модели
+// свои потоки обучения и свой выходной файл. Конфигурации моделей задаются в файле -models, по одной в строке,
+// в виде параметров SweepModelCommandLineParameters; пустые строки и строки, начинающиеся с '#', пропускаются.
+int main(int argc, char **argv)
+{
+  // выполняем разбор параметров командной строки
+  SweepCommandLineParameters cmdLineParams;
+  cmdLineParams.parse(argc, argv);
+  cmdLineParams.dbg_cout();
+
+  if (!cmdLineParams.isDefined("-words-vocab") || !cmdLineParams.isDefined("-train") || !cmdLineParams.isDefined("-models"))
+    return 0;
+
+  SimpleProfiler global_profiler;
+
+  // чтение конфигураций моделей
+  std::vector<SweepModelCommandLineParameters> models;
+  std::ifstream models_file( cmdLineParams.getAsString("-models") );
+  if ( !models_file.good() )
+  {
+    std::cerr << "Can't open models file: " << cmdLineParams.getAsString("-models") << std::endl;
+    return -1;
+  }
+  std::string line;
+  while ( std::getline(models_file, line) )
+  {
+    std::istringstream iss(line);
+    std::vector<std::string> args{"sweep"};
+    std::string arg;
+    while (iss >> arg)
+      args.push_back(arg);
+    if (args.size() == 1 || args[1][0] == '#') continue;
+    std::vector<char*> argv_model;
+    for (auto&& a : args)
+      argv_model.push_back(a.data());
+    models.emplace_back();
+    models.back().parse(argv_model.size(), argv_model.data());
+    const std::string model = models.back().getAsString("-model");
+    if ( !models.back().isDefined("-output") || (model != "cbow" && model != "sg") || models.back().getAsInt("-window") < 1 )
+    {
+      std::cerr << "Invalid model configuration (-model cbow|sg, -window >= 1 and -output are required): " << line << std::endl;
+      return -1;
+    }
+  }
+  if (models.empty())
+  {
+    std::cerr << "No model configurations in: " << cmdLineParams.getAsString("-models") << std::endl;
+    return -1;
+  }
+  std::cout << "Models: " << models.size() << std::endl;
+  for (auto&& model : models)
+    model.dbg_cout();
+
+  // загрузка словаря
+  std::shared_ptr< OriginalWord2VecVocabulary> v = std::make_shared< OriginalWord2VecVocabulary>();
+  if ( !v->load( cmdLineParams.getAsString("-words-vocab") ) )
+    return -1;
+
+  // общий для всех моделей поток предложений
+  const size_t threads_count = std::max(cmdLineParams.getAsInt("-threads"), 1);
+  const size_t epochs_count = std::max(cmdLineParams.getAsInt("-iter"), 1);
+  std::shared_ptr< OriginalWord2VecLearningExampleProvider> reader = std::make_shared< OriginalWord2VecLearningExampleProvider > ( cmdLineParams.getAsString("-train"),
+                                                                                                                                   threads_count,
+                                                                                                                                   1,
+                                                                                                                                   cmdLineParams.getAsFloat("-sample"),
+                                                                                                                                   v );
+  std::shared_ptr< SharedSentenceStream > stream = std::make_shared< SharedSentenceStream >(reader, threads_count, models.size(), epochs_count);
+
+  // создаем объекты, организующие обучение моделей
+  std::vector< std::unique_ptr<CustomTrainer> > trainers;
+  for (size_t m = 0; m < models.size(); ++m)
+  {
+    auto&& model = models[m];
+    std::shared_ptr< CustomLearningExampleProvider> lep = std::make_shared< SharedStreamLearningExampleProvider >(stream, m, threads_count, model.getAsInt("-window"));
+    const bool is_cbow = (model.getAsString("-model") == "cbow");
+    const float alpha = model.isDefined("-alpha") ? model.getAsFloat("-alpha") : (is_cbow ? 0.05 : 0.025);
+    UpdateRule update_rule = urSgd;
+    if ( !parse_update_rule(model.getAsString("-optimizer"), update_rule) )
+    {
+      std::cerr << "Unknown -optimizer value: " << model.getAsString("-optimizer") << std::endl;
+      return -1;
+    }
+    if (is_cbow)
+      trainers.emplace_back( std::make_unique<CbowTrainer_Mikolov>(lep, v, v, model.getAsInt("-size"), epochs_count, alpha, model.getAsString("-optimization"), model.getAsInt("-negative")) );
+    else
+      trainers.emplace_back( std::make_unique<SgTrainer_Mikolov>(lep, v, v, model.getAsInt("-size"), epochs_count, alpha, model.getAsString("-optimization"), model.getAsInt("-negative")) );
+    trainers.back()->set_update_rule(update_rule);
+    trainers.back()->init_net(threads_count);
+  }
+
+  // запускаем потоки, осуществляющие обучение (threads_count потоков на каждую модель)
+  std::vector<std::thread> threads_vec;
+  threads_vec.reserve(threads_count * trainers.size());
+  for (auto&& trainer : trainers)
+    for (size_t i = 0; i < threads_count; ++i)
+      threads_vec.emplace_back(&CustomTrainer::train_entry_point, trainer.get(), i);
+  for (auto&& thread : threads_vec)
+    thread.join();
+  std::cout << std::endl;
+
+  // сохраняем вычисленные вектора в файлы
+  for (size_t m = 0; m < models.size(); ++m)
+    trainers[m]->saveEmbeddings( models[m].getAsString("-output") );
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef SWEEP_COMMAND_LINE_PARAMETERS_H_
+#define SWEEP_COMMAND_LINE_PARAMETERS_H_
+
+#include "command_line_parameters.h"
+
+class SweepCommandLineParameters : public CommandLineParameters
+{
+public:
+  SweepCommandLineParameters()
+  {
+    // initialize params mapping with std::initialzer_list<T>
+    params_ = {
+        {"-words-vocab",  {"The words vocabulary will be read from <file>", std::nullopt, std::nullopt}},
+        {"-train",        {"Use text data from <file> (directory, comma-separated list or @list) to train the models", std::nullopt, std::nullopt}},
+        {"-models",       {"Read model configurations from <file>, one per line (see SweepModelCommandLineParameters)", std::nullopt, std::nullopt}},
+        {"-sample",       {"Set threshold for occurrence of words. Those that appear with higher frequency in the training data will be randomly down-sampled", "1e-3", std::nullopt}},
+        {"-iter",         {"Run more training iterations", "5", std::nullopt}},
+        {"-threads",      {"Use <int> threads per model", "12", std::nullopt}}
+    };
+  }
+};
+
+// параметры одной модели (строка файла -models), например: -model cbow -size 200 -window 8 -output cbow200.bin
+class SweepModelCommandLineParameters : public CommandLineParameters
+{
+public:
+  SweepModelCommandLineParameters()
+  {
+    // initialize params mapping with std::initialzer_list<T>
+    params_ = {
+        {"-model",        {"Learning model: cbow or sg", "cbow", std::nullopt}},
+        {"-output",       {"Use <file> to save the resulting word vectors", std::nullopt, std::nullopt}},
+        {"-size",         {"Set size of word vectors", "100", std::nullopt}},
+        {"-window",       {"Set max skip length between words", "5", std::nullopt}},
+        {"-optimization", {"Optimization method: hierarchical softmax (hs) or negative sampling (ns)", "ns", std::nullopt}},
+        {"-negative",     {"Number of negative examples", "5", std::nullopt}},
+        {"-alpha",        {"Set the starting learning rate (default: 0.05 for cbow, 0.025 for sg)", std::nullopt, std::nullopt}},
+        {"-optimizer",    {"Weights update rule: sgd or adagrad (sparse, one accumulator per row; usually needs a 4 times higher -alpha)", "sgd", std::nullopt}}
+    };
+  }
+};
+
+#endif /* SWEEP_COMMAND_LINE_PARAMETERS_H_ */
@@ -0,0 +1,168 @@
+#ifndef TOKENIZER_H_
+#define TOKENIZER_H_
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "corpus_reader.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define W2V_TOKENIZER_SSE2
+#endif
+
+
+// Токенизатор обучающего множества, общий для build_dict и поставщиков обучающих примеров.
+// Семантика совпадает с функцией read_word оригинального word2vec: разделители -- space, tab и EOL, символ CR пропускается
+// (в том числе внутри слова), пустая позиция перед EOL дает маркер конца предложения "</s>", слово обрезается
+// до MAX_STRING байт. В конце файла (eof() == true) прочитанное слово не используется.
+// Вместо побайтного чтения границы слов ищутся сразу в буфере: по 16 байт за сравнение (SSE2) либо по 8 байт (SWAR).
+
+
+// максимальная длина слова (более длинные слова обрезаются)
+const size_t MAX_STRING = 100;
+
+
+namespace tokenizer_internal
+{
+  inline bool is_delimiter(unsigned char ch)
+  {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+  }
+
+  // поиск первого байта из {space, tab, LF, CR} в [first; last); last, если таких нет
+  inline const char* find_delimiter(const char *first, const char *last)
+  {
+#ifdef W2V_TOKENIZER_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; last - first >= 16; first += 16)
+    {
+      const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+      const __m128i hits = _mm_or_si128( _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)),
+                                         _mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, cr)) );
+      const int mask = _mm_movemask_epi8(hits);
+      if (mask != 0)
+      {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return first + idx;
+#else
+        return first + __builtin_ctz(mask);
+#endif
+      }
+    }
+#else
+    // все разделители не превышают 0x20: сначала по 8 байт отбираются кандидаты (байты < 0x21), затем проверяются точно
+    const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+    for (; last - first >= 8; first += 8)
+    {
+      uint64_t block;
+      memcpy(&block, first, sizeof(block));
+      if ( ((block - ones * 0x21) & ~block & highs) == 0 ) continue;
+      for (size_t i = 0; i < 8; ++i)
+        if ( is_delimiter(first[i]) ) return first + i;
+    }
+#endif
+    for (; first != last; ++first)
+      if ( is_delimiter(*first) ) return first;
+    return last;
+  } // function-end
+} // namespace tokenizer_internal
+
+
+// чтение одного слова
+inline void read_word(CorpusReader& fin, std::string& word)
+{
+  word.clear();
+  if ( fin.eof() ) return;
+  size_t a = 0;   // длина слова до обрезания
+  while (true)
+  {
+    size_t avail = fin.available();
+    if (avail == 0)
+    {
+      // как и при побайтном чтении, в конце файла к слову добавляется символ EOF
+      if ( a < MAX_STRING )
+        word.push_back( static_cast<char>(EOF) );
+      return;
+    }
+    const char *first = fin.current();
+    const char *last = first + avail;
+    if (a == 0)
+    {
+      // пропускаем разделители перед словом; EOL перед словом -- конец предложения
+      while (first != last && (*first == ' ' || *first == '\t' || *first == '\r'))
+        ++first;
+      if (first != last && *first == '\n')
+      {
+        fin.skip(first + 1 - fin.current());
+        word = "</s>";
+        return;
+      }
+      if (first == last)
+      {
+        fin.skip(avail);
+        continue;
+      }
+    }
+    const char *delimiter = tokenizer_internal::find_delimiter(first, last);
+    const size_t chunk = delimiter - first;
+    if ( a < MAX_STRING )
+      word.append(first, std::min(chunk, MAX_STRING - a));
+    a += chunk;
+    if (delimiter == last)
+    {
+      fin.skip(avail);
+      continue;
+    }
+    if (*delimiter == '\r')  // CR внутри слова пропускается
+    {
+      fin.skip(delimiter + 1 - fin.current());
+      continue;
+    }
+    // EOL после слова остается непрочитанным (он даст "</s>" при следующем вызове), space и tab -- пропускаются
+    fin.skip(delimiter + (*delimiter == '\n' ? 0 : 1) - fin.current());
+    return;
+  }
+} // function-end
+
+
+// побайтная реализация (функция read_word оригинального word2vec) -- эталон для проверки read_word (см. бенчмарки)
+inline void read_word_bytewise(CorpusReader& fin, std::string& word)
+{
+  word.clear();
+  size_t a = 0;
+  while ( !fin.eof() )
+  {
+    int ch = fin.get();
+    if (ch == 13) continue;   //  \r
+    if ((ch == ' ') || (ch == '\t') || (ch == '\n'))
+    {
+      // если есть прочитанный фрагмент слова
+      if (a > 0)
+      {
+        if (ch == '\n')
+          fin.unget();
+        break;
+      }
+      // если прочитанного фрагмента слова нет
+      if (ch == '\n')
+      {
+        word = "</s>";
+        return;
+      }
+      else
+        continue;
+    } // if (delimiter) ...
+    if ( a < MAX_STRING )
+      word.push_back( ch );
+    ++a;
+  }
+} // function-end
+
+
+#endif /* TOKENIZER_H_ */
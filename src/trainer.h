@@ -2,16 +2,22 @@
 #define TRAINER_H_
 
 #include <memory>
+#include <vector>
 #include <string>
 #include <chrono>
 #include <iostream>
-
-#ifdef _MSC_VER
-  #define posix_memalign(p, a, s) (((*(p)) = _aligned_malloc((s), (a))), *(p) ? 0 : errno)
-  #define free_aligned(p) _aligned_free((p))
-#else
-  #define free_aligned(p) free((p))
-#endif
+#include <thread>
+#include <fstream>
+#include <utility>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include "profiler.h"
+#include "weights_memory.h"
+#include "weights_precision.h"
+#include "hot_rows.h"
+#include "parameter_averaging.h"
 
 
 #define EXP_TABLE_SIZE 1000
@@ -24,6 +30,44 @@ enum LearningOptimizationAlgo
   loaNegativeSampling
 };
 
+// правило обновления весов: SGD с общим для всех строк коэффициентом скорости обучения (как в word2vec)
+// либо разреженный построчный AdaGrad (коэффициент каждой строки делится на корень из накопленного квадрата её градиентов)
+enum UpdateRule
+{
+  urSgd,
+  urAdaGrad
+};
+
+inline bool parse_update_rule(const std::string& str, UpdateRule& rule)
+{
+  if (str == "sgd") rule = urSgd;
+  else if (str == "adagrad") rule = urAdaGrad;
+  else return false;
+  return true;
+}
+
+
+// непрерывный фрагмент памяти: указатель и количество элементов (аналог std::span из C++20)
+template <typename T>
+struct Span
+{
+  T *ptr = nullptr;
+  size_t count = 0;
+  T* data() const { return ptr; }
+  size_t size() const { return count; }
+  T* begin() const { return ptr; }
+  T* end() const { return ptr + count; }
+  T& operator[](size_t idx) const { return ptr[idx]; }
+};
+
+
+// накопитель выборочно отслеживаемой функции потерь (см. CustomTrainer::set_loss_sampling)
+struct LossAccumulator
+{
+  double sum = 0;       // сумма функции потерь (отрицательного логарифма правдоподобия) по бинарным классификаторам
+  uint64_t count = 0;   // количество предсказаний (слагаемых sum: положительных и отрицательных примеров или узлов дерева Хаффмана)
+};
+
 
 // хранит общие параметры и данные для всех потоков
 // реализует общую логику обучения (которая затем специализируется для cbow и skip-gram, соответственно)
@@ -71,35 +115,258 @@ public:
   virtual ~CustomTrainer()
   {
     free(expTable);
-    if (syn0)
-      free_aligned(syn0);
-    if (syn1)
-      free_aligned(syn1);
     if (table)
       free(table);
   }
+  // задание способа размещения весовых матриц в памяти и привязки потоков к ядрам (до вызова init_net)
+  void set_memory_placement(const MemoryPlacement& memory_placement)
+  {
+    placement = memory_placement;
+  }
+  // задание формата хранения весовых матриц (до вызова init_net)
+  void set_weights_precision(WeightsPrecision weights_precision)
+  {
+    precision = weights_precision;
+  }
+  // задание количества горячих строк каждой весовой матрицы, обновляемых потоками в частных копиях,
+  // и периодичности (в обучающих примерах) их синхронизации с общими матрицами; rows == 0 -- режим выключен
+  void set_hot_rows(size_t rows, size_t flush_interval)
+  {
+    hot_rows_count = rows;
+    hot_rows_flush_interval = std::max<size_t>(flush_interval, 1);
+  }
+  // задание правила обновления весов (до вызова init_net)
+  // при разреженном AdaGrad для каждой строки syn0 и syn1 хранится накопитель -- сумма квадратов норм градиентов строки
+  // (в расчете на элемент); накопитель обновляется только у строк, затронутых обучающим примером, и шаг строки равен
+  // alpha / sqrt(накопитель), так что строки редких слов обучаются с большим шагом, чем строки частотных;
+  // alpha по-прежнему линейно убывает к концу обучения (начальное значение обычно нужно вчетверо большее, чем при SGD);
+  // накопители не сохраняются в резервную копию и после restore начинаются заново
+  void set_update_rule(UpdateRule rule)
+  {
+    update_rule = rule;
+  }
+  // задание глубины упреждающей выборки: строки весовых матриц, нужные для обучающего примера, загружаются в кэш
+  // за examples примеров до его обработки (а строка очередного отрицательного примера -- за один отрицательный пример);
+  // examples == 0 -- режим выключен; результат обучения от глубины не зависит
+  void set_prefetch(size_t examples)
+  {
+    prefetch_distance = examples;
+  }
+  // отслеживание функции потерь на каждом every-м обучающем примере (every == 0 -- выключено) с выводом её среднего значения
+  // по окончании каждой эпохи; при min_improvement > 0 обучение завершается после эпохи, на которой функция потерь уменьшилась
+  // относительно предыдущей эпохи менее чем на долю min_improvement (потоки, начавшие следующую эпоху, останавливаются
+  // при ближайшем выводе прогресс-сообщения); результат обучения от отслеживания не зависит
+  void set_loss_sampling(size_t every, float min_improvement = 0)
+  {
+    loss_sampling = every;
+    early_stop_improvement = min_improvement;
+  }
+  // обучение было завершено досрочно по критерию set_loss_sampling
+  bool early_stopped() const
+  {
+    return early_stopped_flag.load();
+  }
+  // задание срока окончания обучения (-time-budget): скорость обучения (alpha) убывает до минимальной к сроку, а по его
+  // наступлении потоки прекращают обучение, даже если заданные эпохи не пройдены (количество эпох становится верхней границей);
+  // срок сдвигается на оценку времени сохранения результата (with_backup -- будет сохранена и резервная копия)
+  // и на 2% оставшегося времени (завершение потоков и процесса)
+  void set_deadline(std::chrono::steady_clock::time_point deadline, bool with_backup = false)
+  {
+    const std::chrono::duration<double> remaining = deadline - std::chrono::steady_clock::now();
+    const double reserve = estimated_save_seconds(with_backup) + 0.02 * std::max(remaining.count(), 0.0);
+    deadline_tp = deadline - std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>(reserve) );
+    has_deadline = true;
+  }
+  // обучение было прервано по наступлении срока
+  bool deadline_reached() const
+  {
+    return time_is_up.load();
+  }
+  // досрочное завершение обучения (из любого потока): потоки обучения прекращают работу при ближайшем выводе прогресс-сообщения
+  void request_stop()
+  {
+    stop_requested = true;
+  }
+  // состояние обучения для внешнего наблюдения (экспорт метрик, см. metrics_exporter.h)
+  struct Status
+  {
+    double elapsed_seconds = 0;               // время с начала обучения
+    float alpha = 0;                          // текущий коэффициент скорости обучения
+    float progress = 0;                       // доля пройденного обучения (0..1)
+    double eta_seconds = -1;                  // оценка времени до окончания обучения; < 0 -- оценки еще нет
+    double epoch_loss = -1;                   // среднее значение функции потерь за последнюю завершенную эпоху; < 0 -- не отслеживается
+    std::vector<uint64_t> thread_words;       // количество слов, пройденных каждым потоком (за все эпохи)
+    std::vector<uint64_t> thread_epoch;       // текущая эпоха каждого потока (с 1; 0 -- поток еще не начал обучение)
+    std::vector<uint64_t> thread_lookahead;   // количество обучающих примеров, прочитанных потоком заранее (-prefetch)
+  };
+  // получение состояния обучения (из любого потока, в том числе во время обучения);
+  // значения обновляются потоками обучения одновременно с выводом прогресс-сообщений (примерно каждые 10000 слов)
+  Status status() const
+  {
+    Status result;
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    result.elapsed_seconds = std::chrono::duration<double>(now - start_learning_tp).count();
+    result.alpha = published_alpha.load(std::memory_order_relaxed);
+    result.progress = published_progress.load(std::memory_order_relaxed);
+    result.epoch_loss = published_loss.load(std::memory_order_relaxed);
+    if (result.progress > 0)
+      result.eta_seconds = result.elapsed_seconds * (1 - result.progress) / result.progress;
+    if (has_deadline)
+    {
+      const double left = std::max(std::chrono::duration<double>(deadline_tp - now).count(), 0.0);
+      result.eta_seconds = (result.eta_seconds < 0) ? left : std::min(result.eta_seconds, left);
+    }
+    for (size_t t = 0; t < thread_status_count; ++t)
+    {
+      result.thread_words.push_back( thread_status[t].words.load(std::memory_order_relaxed) );
+      result.thread_epoch.push_back( thread_status[t].epoch.load(std::memory_order_relaxed) );
+      result.thread_lookahead.push_back( thread_status[t].lookahead.load(std::memory_order_relaxed) );
+    }
+    return result;
+  } // method-end
+  // статья расчета потребности в памяти (см. memory_plan)
+  struct MemoryPlanItem
+  {
+    std::string name;
+    uint64_t bytes = 0;                       // объем, занимаемый на протяжении всего обучения
+    std::string note;                         // пояснение (из чего складывается объем)
+  };
+  // расчет потребности в памяти для обучения threads_count потоками при заданных размещении, формате весов, горячих строках
+  // и упреждающей выборке (до вызова init_net; словари, поставщик обучающих примеров и таблица шума к этому моменту уже созданы);
+  // transient_bytes -- память, нужная лишь на время инициализации нейросети (построение дерева Хаффмана)
+  std::vector<MemoryPlanItem> memory_plan(size_t threads_count, uint64_t& transient_bytes) const
+  {
+    std::vector<MemoryPlanItem> plan;
+    transient_bytes = 0;
+    const size_t element_size = weights_element_size(precision);
+    const uint64_t row_bytes = layer1_size * element_size;
+    const size_t in_rows = in_vocabulary->size(), out_rows = out_vocabulary->size();
+    const size_t nodes = (out_rows > 1) ? out_rows - 1 : 0;
+    const std::string row_note = std::to_string(layer1_size) + " x " + std::to_string(element_size) + " bytes per row";
+    if (placement.file_backed())
+    {
+      // в памяти находятся лишь закрепленные строки, остальные -- в страничном кэше по мере обращения к ним (см. init_net)
+      const size_t in_pinned = std::min(placement.resident_rows, in_rows);
+      const size_t out_pinned = std::min(placement.resident_rows, (optimization_algo == loaHierarchicalSoftmax) ? nodes : out_rows);
+      plan.push_back({"syn0", in_pinned * row_bytes, std::to_string(in_pinned) + " resident of " + std::to_string(in_rows) + " rows, file "
+                                                     + std::to_string(in_rows * row_bytes) + " bytes in " + placement.weights_dir});
+      plan.push_back({"syn1", out_pinned * row_bytes, std::to_string(out_pinned) + " resident of " + std::to_string(out_rows) + " rows, file "
+                                                      + std::to_string(out_rows * row_bytes) + " bytes in " + placement.weights_dir});
+    }
+    else
+    {
+      plan.push_back({"syn0", WeightsBlock::allocation_bytes(in_rows * row_bytes, placement), std::to_string(in_rows) + " rows, " + row_note});
+      plan.push_back({"syn1", WeightsBlock::allocation_bytes(out_rows * row_bytes, placement), std::to_string(out_rows) + " rows, " + row_note});
+    }
+    if (table)
+      plan.push_back({"noise table", heap_block_bytes(table_size * sizeof(word_index_t)), std::to_string(table_size) + " entries, negative sampling"});
+    if (update_rule == urAdaGrad)
+      plan.push_back({"adagrad accumulators", heap_block_bytes(in_rows * sizeof(float)) + heap_block_bytes(out_rows * sizeof(float)), "one float per row of syn0 and syn1"});
+    plan.push_back({"exp table", heap_block_bytes((EXP_TABLE_SIZE + 1) * sizeof(float)), ""});
+    plan.push_back({"words vocabulary", w_vocabulary->memory_bytes(), std::to_string(w_vocabulary->size()) + " words with hash index"});
+    if (c_vocabulary != w_vocabulary)
+      plan.push_back({"contexts vocabulary", c_vocabulary->memory_bytes(), std::to_string(c_vocabulary->size()) + " contexts with hash index"});
+    if (optimization_algo == loaHierarchicalSoftmax)
+    {
+      uint64_t tree_bytes = 0;
+      plan.push_back({"huffman codes and paths", out_vocabulary->huffman_memory_bytes(tree_bytes), std::to_string(nodes) + " inner nodes"});
+      transient_bytes += tree_bytes;
+    }
+    plan.push_back({"learning example provider", lep->memory_bytes(), "read buffers of " + std::to_string(threads_count) + " threads, subsampling table"});
+    // буферы потока: выход скрытого слоя и ошибка (neu1, neu1e), частные копии горячих строк (рабочая и снимок, см. hot_rows.h),
+    // обучающие примеры, прочитанные заранее (без векторов контекстов)
+    auto replica_bytes = [row_bytes](size_t rows) -> uint64_t
+                         {
+                           return 2 * heap_block_bytes((rows * row_bytes + sizeof(float) - 1) / sizeof(float) * sizeof(float));
+                         };
+    const size_t hot_in = std::min(hot_rows_count, in_rows);
+    const size_t hot_out = std::min(hot_rows_count, (optimization_algo == loaHierarchicalSoftmax) ? nodes : out_rows);
+    const uint64_t thread_bytes = 2 * heap_block_bytes(layer1_size * sizeof(float)) + replica_bytes(hot_in) + replica_bytes(hot_out)
+                                  + ((prefetch_distance > 0) ? (prefetch_distance + 1) * sizeof(std::pair<std::optional<LearningExample>, uint64_t>) : 0);
+    plan.push_back({"thread buffers", threads_count * thread_bytes, std::to_string(threads_count) + " x " + std::to_string(thread_bytes) + " bytes"});
+    return plan;
+  } // method-end
+  // количество слов, которое предстоит пройти за все эпохи (по set_train_words)
+  uint64_t planned_words() const
+  {
+    return epoch_count * train_words;
+  }
+  // предполагаемая скорость записи результата (байт в секунду) -- с запасом для сетевых файловых систем
+  static constexpr double SAVE_BYTES_PER_SECOND = 100e6;
+  // оценка времени сохранения эмбеддингов (и резервной копии)
+  double estimated_save_seconds(bool with_backup) const
+  {
+    const double row_bytes = layer1_size * sizeof(float) + 16;  // вектор и (в среднем) слово
+    double bytes = in_vocabulary->size() * row_bytes;
+    if (with_backup)
+      bytes += 2 * w_vocabulary->size() * row_bytes + w_vocabulary->size() * 16.0;
+    return bytes / SAVE_BYTES_PER_SECOND;
+  }
+  // задание количества слов, перебираемых за эпоху (по умолчанию -- сумма частот словаря); используется для расчета прогресса
+  // и скорости обучения, когда обучающее множество не совпадает с тем, по которому построен словарь
+  // (при распределенном обучении процесс перебирает лишь свою часть, при дообучении -- только новые тексты)
+  void set_train_words(uint64_t words)
+  {
+    train_words = std::max<uint64_t>(words, 1);
+  }
+  // передача весовых матриц (после init_net) на синхронизацию с другими процессами распределенного обучения
+  void attach_parameter_averaging(ParameterAveragingWorker& worker)
+  {
+    worker.attach(syn0, syn1, precision);
+  }
   // функция инициализации нейросети
-  void init_net()
+  // матрицы заполняются параллельно threads_count потоками (привязанными к ядрам так же, как потоки обучения),
+  // чтобы на NUMA-системах страницы распределялись между узлами; результат не зависит от количества потоков
+  void init_net(size_t threads_count = 1)
   {
     size_t in_vocab_size = in_vocabulary->size();
     size_t out_vocab_size = out_vocabulary->size();
-    long long ap;
-    unsigned long long next_random = 1;
 
-    ap = posix_memalign((void **)&syn0, 128, (long long)in_vocab_size * layer1_size * sizeof(float));
-    if (syn0 == nullptr || ap != 0) {std::cerr << "Memory allocation failed" << std::endl; exit(1);}
-    for (size_t a = 0; a < in_vocab_size; ++a)
-      for (size_t b = 0; b < layer1_size; ++b)
+    const size_t row_bytes = layer1_size * weights_element_size(precision);
+    if (placement.file_backed())
+    {
+      // в памяти закрепляются строки частотных слов -- первые строки матриц (словарь упорядочен по убыванию частоты);
+      // при hierarchical softmax строки syn1 соответствуют узлам дерева Хаффмана, и закрепляются последние строки (узлы у вершины)
+      const size_t in_pinned = std::min(placement.resident_rows, in_vocab_size);
+      size_t out_pinned_begin = 0, out_pinned = std::min(placement.resident_rows, out_vocab_size);
+      if (optimization_algo == loaHierarchicalSoftmax)
       {
-        next_random = next_random * (unsigned long long)25214903917 + 11;
-        syn0[a * layer1_size + b] = (((next_random & 0xFFFF) / (float)65536) - 0.5) / layer1_size;
+        const size_t nodes = (out_vocab_size > 1) ? out_vocab_size - 1 : 0;
+        out_pinned = std::min(placement.resident_rows, nodes);
+        out_pinned_begin = nodes - out_pinned;
       }
+      if ( !syn0_block.map_file(in_vocab_size * row_bytes, placement, "w2vxx_syn0", 0, in_pinned * row_bytes) ) exit(1);
+      if ( !syn1_block.map_file(out_vocab_size * row_bytes, placement, "w2vxx_syn1", out_pinned_begin * row_bytes, out_pinned * row_bytes) ) exit(1);
+      std::cout << "Weights are mapped to files in " << placement.weights_dir << ": " << (in_vocab_size + out_vocab_size) * row_bytes / 1048576.0
+                << " MB, resident rows: syn0 " << in_pinned << ", syn1 " << out_pinned << std::endl;
+    }
+    else
+    {
+      if ( !syn0_block.allocate(in_vocab_size * row_bytes, placement) ) {std::cerr << "Memory allocation failed" << std::endl; exit(1);}
+      if ( !syn1_block.allocate(out_vocab_size * row_bytes, placement) ) {std::cerr << "Memory allocation failed" << std::endl; exit(1);}
+    }
+    syn0 = syn0_block.data();
+    syn1 = syn1_block.data();
+    if (update_rule == urAdaGrad)
+    {
+      adagrad_syn0.assign(in_vocab_size, ADAGRAD_INITIAL_ACCUMULATOR);
+      adagrad_syn1.assign(out_vocab_size, ADAGRAD_INITIAL_ACCUMULATOR);
+    }
 
-    ap = posix_memalign((void **)&syn1, 128, (long long)out_vocab_size * layer1_size * sizeof(float));
-    if (syn1 == nullptr || ap != 0) {std::cerr << "Memory allocation failed" << std::endl; exit(1);}
-    for (size_t a = 0; a < out_vocab_size; ++a)
-      for (size_t b = 0; b < layer1_size; ++b)
-        syn1[a * layer1_size + b] = 0;
+    threads_count = std::max<size_t>(threads_count, 1);
+    std::vector<std::thread> threads_vec;
+    threads_vec.reserve(threads_count);
+    for (size_t t = 0; t < threads_count; ++t)
+      threads_vec.emplace_back([this, t, threads_count, in_vocab_size, out_vocab_size]()
+                               {
+                                 pin_current_thread(t, placement.pinning);
+                                 init_rows(syn0, in_vocab_size * t / threads_count, in_vocab_size * (t + 1) / threads_count, true);
+                                 // файл весов изначально заполнен нулями, и запись нулей лишь породила бы лишний ввод-вывод
+                                 if ( !syn1_block.is_file_mapped() )
+                                   init_rows(syn1, out_vocab_size * t / threads_count, out_vocab_size * (t + 1) / threads_count, false);
+                               });
+    for (auto& thread : threads_vec)
+      thread.join();
 
     if (optimization_algo == loaHierarchicalSoftmax) // hierarchical softmax
       out_vocabulary->buildHuffmanTree();
@@ -110,20 +377,39 @@ public:
       std::cerr << "Unknown learning optimization algorithm" << std::endl;
       exit(1);
     }
+    reset_status(threads_count);
     start_learning_tp = std::chrono::steady_clock::now();
   } // method-end
   // обобщенная процедура обучения (точка входа для потоков)
   void train_entry_point( size_t thread_idx )
   {
     next_random_ns = thread_idx;
+    seed_weights_rounding(thread_idx);
+    pin_current_thread(thread_idx, placement.pinning);
+    Profiler::instance().thread_start(thread_idx);
     // выделение памяти для хранения выхода скрытого слоя и величины ошибки
     float *neu1 = (float *)calloc(layer1_size, sizeof(float));
     float *neu1e = (float *)calloc(layer1_size, sizeof(float));
+    // частные копии горячих строк весовых матриц
+    HotRows hot_rows;
+    init_hot_rows(hot_rows);
+    // обучающие примеры, прочитанные заранее (при упреждающей выборке), вместе со счетчиком слов на момент их чтения
+    std::deque< std::pair<std::optional<LearningExample>, uint64_t> > lookahead;
+    // состояние потока для внешнего наблюдения и количество слов, пройденных в предыдущих эпохах
+    ThreadStatus *t_status = (thread_idx < thread_status_count) ? &thread_status[thread_idx] : nullptr;
+    uint64_t words_before_epoch = 0;
+    // выборочно отслеживаемая функция потерь текущей эпохи и счетчик обучающих примеров для выбора отслеживаемых
+    LossAccumulator epoch_loss;
+    uint64_t examples_seen = 0;
     // цикл по эпохам
     for (size_t epochIdx = 0; epochIdx < epoch_count; ++epochIdx)
     {
+      profile_section(psInputTokenize);
+      // при ошибке подготовки эпохи поток завершается через общий выход (с освобождением буферов)
       if ( !lep->epoch_prepare(thread_idx) )
-        return;
+        break;
+      if (t_status)
+        t_status->epoch.store(epochIdx + 1, std::memory_order_relaxed);
       long long word_count = 0, last_word_count = 0;
       // цикл по словам
       while (true)
@@ -134,41 +420,160 @@ public:
         {
           word_count_actual += (word_count - last_word_count);
           last_word_count = word_count;
+          std::chrono::steady_clock::time_point current_learning_tp = std::chrono::steady_clock::now();
+          std::chrono::duration< double, std::ratio<1> > learning_seconds = current_learning_tp - start_learning_tp;
+          // доля пройденного обучения: по количеству слов, а при заданном сроке -- по времени, если оно истекает раньше
+          float progress = word_count_actual / (float)(epoch_count * train_words + 1);
+          if (has_deadline)
+          {
+            const std::chrono::duration<double> budget = deadline_tp - start_learning_tp;
+            const float time_progress = (budget.count() > 0) ? learning_seconds.count() / budget.count() : 1;
+            if (time_progress >= 1)
+              time_is_up = true;
+            progress = std::max(progress, std::min(time_progress, 1.0f));
+          }
           //if ( debug_mode > 1 )
           {
-            std::chrono::steady_clock::time_point current_learning_tp = std::chrono::steady_clock::now();
-            std::chrono::duration< double, std::ratio<1> > learning_seconds = current_learning_tp - start_learning_tp;
             printf("%cAlpha: %f  Progress: %.2f%%  Words/sec: %.2fk  ", 13, alpha,
-              word_count_actual / (float)(epoch_count * train_words + 1) * 100,
+              progress * 100,
               word_count_actual / (learning_seconds.count() * 1000) );
+            // при заданном сроке -- оставшееся время и доля слов заданных эпох, которую удастся пройти при текущей скорости
+            if (has_deadline)
+            {
+              const std::chrono::duration<double> left = deadline_tp - current_learning_tp;
+              const std::chrono::duration<double> budget = deadline_tp - start_learning_tp;
+              printf("Time left: %.0fs  Expected coverage: %.1f%%  ", std::max(left.count(), 0.0),
+                std::min(100.0, word_count_actual / std::max(learning_seconds.count(), 1e-9) * budget.count() / (epoch_count * train_words + 1) * 100));
+            }
+            // при размещении весов в файлах скорость обучения определяется подгрузкой строк с диска
+            uint64_t major_faults = 0, minor_faults = 0;
+            if ( placement.file_backed() && page_faults(major_faults, minor_faults) )
+              printf("Major page faults: %lu (%.0f/sec)  ", major_faults, major_faults / learning_seconds.count());
             fflush(stdout);
           }
-          alpha = starting_alpha * (1 - word_count_actual / (float)(epoch_count * train_words + 1));
+          if (thread_idx == 0)
+            Profiler::instance().poll_dump_request();
+          alpha = starting_alpha * (1 - progress);
           if ( alpha < starting_alpha * 0.0001 )
             alpha = starting_alpha * 0.0001;
+          published_alpha.store(alpha, std::memory_order_relaxed);
+          published_progress.store(progress, std::memory_order_relaxed);
+          if (t_status)
+          {
+            t_status->words.store(words_before_epoch + word_count, std::memory_order_relaxed);
+            t_status->lookahead.store(lookahead.size(), std::memory_order_relaxed);
+          }
+          if ( time_is_up.load(std::memory_order_relaxed) || stop_requested.load(std::memory_order_relaxed) ) break;  // срок обучения истек или запрошена остановка
         }
         // читаем очередной обучающий пример
-        auto learning_example = lep->get(thread_idx);
-        word_count = lep->getWordsCount(thread_idx);
+        profile_section(psInputTokenize);
+        std::optional<LearningExample> learning_example;
+        if (prefetch_distance == 0)
+        {
+          learning_example = lep->get(thread_idx);
+          word_count = lep->getWordsCount(thread_idx);
+        }
+        else
+        {
+          // дочитываем примеры до заданной глубины (но не дальше конца эпохи) и запрашиваем в кэш их строки
+          while ( lookahead.size() <= prefetch_distance && (lookahead.empty() || lookahead.back().first) )
+          {
+            auto next_example = lep->get(thread_idx);
+            if (next_example)
+              prefetch_example(next_example.value());
+            lookahead.emplace_back(std::move(next_example), lep->getWordsCount(thread_idx));
+          }
+          learning_example = std::move(lookahead.front().first);
+          word_count = lookahead.front().second;
+          lookahead.pop_front();
+        }
         if (!learning_example) break; // признак окончания эпохи (все обучающие примеры перебраны)
         // используем обучающий пример для обучения нейросети
-        learning_model( learning_example.value(), neu1, neu1e );
+        profile_count(pcExamples);
+        LossAccumulator *sampled_loss = (loss_sampling > 0 && examples_seen++ % loss_sampling == 0) ? &epoch_loss : nullptr;
+        learning_model( learning_example.value(), neu1, neu1e, hot_rows, sampled_loss );
+        if ( hot_rows.tick() )
+          sync_hot_rows(hot_rows);
       } // for all learning examples
+      if ( hot_rows.enabled() )
+        sync_hot_rows(hot_rows);
       word_count_actual += (word_count - last_word_count);
+      words_before_epoch += word_count;
+      if (t_status)
+      {
+        t_status->words.store(words_before_epoch, std::memory_order_relaxed);
+        t_status->lookahead.store(0, std::memory_order_relaxed);
+      }
       if ( !lep->epoch_unprepare(thread_idx) )
-        return;
+        break;
+      if (loss_sampling > 0)
+      {
+        finish_epoch_loss(epochIdx, epoch_loss);
+        epoch_loss = LossAccumulator();
+      }
+      if ( time_is_up.load(std::memory_order_relaxed) || stop_requested.load(std::memory_order_relaxed) ) break;
     } // for all epochs
     free(neu1);
     free(neu1e);
+    Profiler::instance().thread_finish();
   } // method-end: train_entry_point
+  // обучение в threads_count потоках управления (после init_net); управление возвращается по окончании обучения
+  void train(size_t threads_count)
+  {
+    if (threads_count > thread_status_count)
+      reset_status(threads_count);
+    std::vector<std::thread> threads_vec;
+    threads_vec.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i)
+      threads_vec.emplace_back(&CustomTrainer::train_entry_point, this, i);
+    for (auto& thread : threads_vec)
+      thread.join();
+  } // method-end
+  // размерность эмбеддинга
+  size_t embedding_size() const
+  {
+    return layer1_size;
+  }
+  // словарь строк матрицы эмбеддингов (входной словарь модели)
+  const CustomVocabulary& embeddings_vocabulary() const
+  {
+    return *in_vocabulary;
+  }
+  // матрица эмбеддингов без сохранения в файл (для использования w2vxx как библиотеки): строки матрицы input -> hidden,
+  // строка i (embedding_size() чисел) соответствует слову с индексом i входного словаря; при хранении весов с пониженной
+  // точностью возвращается их копия во float (действительна до следующего вызова)
+  Span<const float> embeddings()
+  {
+    const size_t rows = in_vocabulary->size();
+    if (precision == wpFloat32)
+      return {syn0, rows * layer1_size};
+    embeddings_copy.resize(rows * layer1_size);
+    for (size_t a = 0; a < rows; ++a)
+      read_row(syn0, a, embeddings_copy.data() + a * layer1_size);
+    return {embeddings_copy.data(), embeddings_copy.size()};
+  } // method-end
+  // копия первых rows строк матрицы input -> hidden во float (снимок для оценки качества во время обучения, см. snapshot_evaluator.h);
+  // строки читаются без синхронизации с потоками обучения, как и при Hogwild-обновлении весов
+  void snapshot_embeddings(size_t rows, std::vector<float>& snapshot) const
+  {
+    rows = std::min(rows, in_vocabulary->size());
+    snapshot.resize(rows * layer1_size);
+    for (size_t a = 0; a < rows; ++a)
+      read_row(syn0, a, snapshot.data() + a * layer1_size);
+  }
   // функция, реализующая конкретную модель обучения
-  virtual void learning_model(const LearningExample& le, float *neu1, float *neu1e ) = 0;
-  // функция, реализующая сохранение эмбеддингов
+  // (обращения к строкам весовых матриц выполняются через hot_rows, см. hot_rows.h);
+  // если loss != nullptr, то в него добавляется значение функции потерь на данном примере
+  virtual void learning_model(const LearningExample& le, float *neu1, float *neu1e, HotRows& hot_rows, LossAccumulator *loss ) = 0;
+  // упреждающая загрузка в кэш строк весовых матриц, которые понадобятся learning_model для обработки обучающего примера
+  // (кроме строк отрицательных примеров, которые ещё не выбраны)
+  virtual void prefetch_example(const LearningExample& le) = 0;
+  // функция, реализующая сохранение эмбеддингов (строк матрицы input -> hidden; при общем словаре слов и контекстов это вектора слов)
   void saveEmbeddings(const std::string& filename) const
   {
     FILE *fo = fopen(filename.c_str(), "wb");
-    fprintf(fo, "%lu %lu\n", w_vocabulary->size(), layer1_size);
-    saveEmbeddingsBin_helper(fo, w_vocabulary, syn0);
+    fprintf(fo, "%lu %lu\n", in_vocabulary->size(), layer1_size);
+    saveEmbeddingsBin_helper(fo, in_vocabulary, syn0);
     fclose(fo);
   } // method-end
   // функция сохранения обоих весовых матриц в файл
@@ -180,8 +585,88 @@ public:
     saveEmbeddingsBin_helper(fo, w_vocabulary, syn0);
     // сохраняем весовую матрицу между скрытым и выходным слоем
     saveEmbeddingsBin_helper(fo, w_vocabulary, syn1);
+    // сохраняем словарь с частотами (для последующего дообучения); первые строки файла по-прежнему читаются как векторная модель
+    for (size_t a = 0; a < w_vocabulary->size(); ++a)
+      fprintf(fo, "%s %lu\n", w_vocabulary->idx_to_data(a).word.c_str(), w_vocabulary->idx_to_data(a).cn);
     fclose(fo);
   } // method-end
+  // чтение словаря с частотами из файла, сохраненного функцией backup
+  static bool readBackupVocabulary(const std::string& filename, std::vector< std::pair<std::string, uint64_t> >& records)
+  {
+    std::ifstream ifs(filename, std::ios::binary);
+    uint64_t words = 0, size = 0;
+    std::string buf;
+    if ( !(ifs >> words >> size) )
+    {
+      std::cerr << "Can't read backup: " << filename << std::endl;
+      return false;
+    }
+    std::getline(ifs, buf);
+    // пропускаем обе весовые матрицы
+    for (uint64_t r = 0; r < words * 2 && ifs.good(); ++r)
+    {
+      std::getline(ifs, buf, ' ');
+      ifs.ignore(size * sizeof(float) + 1);
+    }
+    records.clear();
+    records.reserve(words);
+    std::string word;
+    uint64_t cn = 0;
+    while ( records.size() < words && (ifs >> word >> cn) )
+      records.emplace_back(word, cn);
+    if (records.size() != words)
+    {
+      std::cerr << "Backup has no vocabulary (it was saved by an older version): " << filename << std::endl;
+      return false;
+    }
+    return true;
+  } // method-end
+  // загрузка весовых матриц из файла, сохраненного функцией backup (после init_net); строки сопоставляются по словам,
+  // поэтому словарь может быть расширен новыми словами (их строки сохраняют начальные значения)
+  // при hierarchical softmax строки syn1 соответствуют узлам дерева Хаффмана, которое перестраивается по новым частотам,
+  // поэтому восстанавливается лишь syn0
+  bool restore(const std::string& filename)
+  {
+    std::ifstream ifs(filename, std::ios::binary);
+    uint64_t words = 0, size = 0;
+    std::string buf;
+    if ( !(ifs >> words >> size) )
+    {
+      std::cerr << "Can't read backup: " << filename << std::endl;
+      return false;
+    }
+    if (size != layer1_size)
+    {
+      std::cerr << "Backup embedding size (" << size << ") differs from -size (" << layer1_size << ")" << std::endl;
+      return false;
+    }
+    std::getline(ifs, buf);
+    std::vector<float> row(layer1_size);
+    size_t restored[2] = {0, 0};
+    for (size_t m = 0; m < 2; ++m)
+    {
+      auto&& vocabulary = (m == 0) ? in_vocabulary : out_vocabulary;
+      const bool skip = (m == 1 && optimization_algo == loaHierarchicalSoftmax);
+      for (uint64_t r = 0; r < words; ++r)
+      {
+        std::getline(ifs, buf, ' ');
+        ifs.read(reinterpret_cast<char*>(row.data()), layer1_size * sizeof(float));
+        ifs.ignore(1);  // конец строки
+        if (!ifs.good())
+        {
+          std::cerr << "Backup is truncated: " << filename << std::endl;
+          return false;
+        }
+        const word_index_t idx = vocabulary->word_to_idx(buf);
+        if (skip || idx >= vocabulary->size()) continue;
+        write_row(m == 0 ? syn0 : syn1, idx, row.data());
+        ++restored[m];
+      }
+    }
+    std::cout << "Restored from backup: syn0 " << restored[0] << " of " << in_vocabulary->size() << " rows, syn1 "
+              << restored[1] << " of " << out_vocabulary->size() << " rows" << std::endl;
+    return true;
+  } // method-end
 
 protected:
   std::shared_ptr< CustomLearningExampleProvider> lep;
@@ -202,20 +687,79 @@ protected:
   // количество отрицательных примеров на каждый положительный при оптимизации методом negative sampling
   size_t negative;
   // матрицы весов между слоями input-hidden и hidden-output
+  // (при хранении с пониженной точностью указатели адресуют 16-битные элементы, см. weights_precision.h)
   float *syn0 = nullptr, *syn1 = nullptr;
+  WeightsBlock syn0_block, syn1_block;
+  // формат хранения весовых матриц
+  WeightsPrecision precision = wpFloat32;
   // табличное представление логистической функции в области определения [-MAX_EXP; +MAX_EXP]
   float *expTable = nullptr;
   // noise distribution for negative sampling
   const size_t table_size = 1e8; // 100 млн.
-  int *table = nullptr;
+  word_index_t *table = nullptr;
   // служебное поле для генерации случайних чисел
   unsigned long long next_random_ns;
+  // размещение весовых матриц в памяти и привязка потоков к ядрам
+  MemoryPlacement placement;
+  // глубина упреждающей выборки строк (в обучающих примерах); 0 -- выключена
+  size_t prefetch_distance = 0;
+  // правило обновления весов и накопители разреженного AdaGrad (по одному на строку syn0 и syn1)
+  UpdateRule update_rule = urSgd;
+  std::vector<float> adagrad_syn0, adagrad_syn1;
+  // начальное значение накопителя: ограничивает шаг строки, еще не получавшей обновлений, величиной alpha / sqrt(значение)
+  static constexpr float ADAGRAD_INITIAL_ACCUMULATOR = 0.1f;
+  // множитель градиента при вычислении g: alpha при SGD, 1 при AdaGrad (коэффициент скорости обучения учитывается в adagrad_rate)
+  inline float gradient_scale() const
+  {
+    return (update_rule == urAdaGrad) ? 1.0f : alpha;
+  }
+  // коэффициент скорости обучения строки row при AdaGrad: в накопитель строки добавляется квадрат нормы её градиента
+  // (в расчете на элемент); накопители, как и веса, обновляются потоками без синхронизации
+  inline float adagrad_rate(std::vector<float>& accumulators, size_t row, float grad_sq_norm)
+  {
+    const float acc = accumulators[row] + grad_sq_norm / layer1_size;
+    accumulators[row] = acc;
+    return alpha / std::sqrt(acc);
+  }
+  // упреждающая загрузка в кэш строки row весовой матрицы (независимо от формата хранения)
+  void prefetch_matrix_row(const float *weight_matrix, size_t row) const
+  {
+    switch (precision)
+    {
+      case wpFloat32:  prefetch_row(weight_matrix + row * layer1_size, layer1_size); break;
+      case wpBFloat16: prefetch_row(reinterpret_cast<const bf16_t*>(weight_matrix) + row * layer1_size, layer1_size); break;
+      case wpFloat16:  prefetch_row(reinterpret_cast<const fp16_t*>(weight_matrix) + row * layer1_size, layer1_size); break;
+    }
+  }
+  // логистическая функция потерь бинарного классификатора с выходом sigma(x): -log(sigma(x)) при label == 1, -log(1 - sigma(x)) при label == 0
+  static inline double logistic_loss(float x, int label)
+  {
+    const double z = label ? -x : x;   // обе формы сводятся к log(1 + e^z)
+    return (z > 0) ? z + std::log1p(std::exp(-z)) : std::log1p(std::exp(z));
+  }
+  // выбор очередного отрицательного примера из таблицы шума (vocab_size -- размер словаря, из которого он выбирается);
+  // при упреждающей выборке строка примера сразу запрашивается в кэш
+  inline word_index_t draw_negative(size_t vocab_size)
+  {
+    next_random_ns = next_random_ns * (unsigned long long)25214903917 + 11;
+    word_index_t target = table[(next_random_ns >> 16) % table_size];
+    if (target == 0) target = next_random_ns % (vocab_size - 1) + 1;
+    if (prefetch_distance > 0)
+      prefetch_matrix_row(syn1, target);
+    return target;
+  }
+  // упреждающая загрузка в кэш строк узлов дерева Хаффмана на пути к слову word_idx выходного словаря
+  void prefetch_huffman_path(word_index_t word_idx) const
+  {
+    for (auto&& node : out_vocabulary->idx_to_data(word_idx).huffman_path)
+      prefetch_matrix_row(syn1, node);
+  }
   // функция инициализации распределения, имитирующего шум, для метода оптимизации negative sampling  -- для словаря слов
   void InitUnigramTable_w()
   {
     double train_words_pow = 0;
     double d1, power = 0.75;
-    table = (int *)malloc(table_size * sizeof(int));
+    table = (word_index_t *)malloc(table_size * sizeof(word_index_t));
     // вычисляем нормирующую сумму  (за слагаемое берется абсолютная частота слова/контекста в степени 3/4)
     for (size_t a = 0; a < w_vocabulary->size(); ++a)
       train_words_pow += pow(w_vocabulary->idx_to_data(a).cn, power);
@@ -234,52 +778,242 @@ protected:
         i = w_vocabulary->size() - 1;
     }
   } // method-end
-//  // функция инициализации распределения, имитирующего шум, для метода оптимизации negative sampling  -- для словаря контекстов
-//  void InitUnigramTable_c()
-//  {
-//    double train_words_pow = 0;
-//    double d1, power = 0.75;
-//    table = (int *)malloc(table_size * sizeof(int));
-//    // вычисляем нормирующую сумму  (за слагаемое берется абсолютная частота слова/контекста в степени 3/4)
-//    for (size_t a = 0; a < c_vocabulary->size(); ++a)
-//      train_words_pow += pow(c_vocabulary->idx_to_data(a).cn, power);
-//    // заполняем таблицу распределения, имитирующего шум
-//    size_t i = 0;
-//    d1 = pow(c_vocabulary->idx_to_data(i).cn, power) / train_words_pow;
-//    for (size_t a = 0; a < table_size; ++a)
-//    {
-//      table[a] = i;
-//      if (a / (double)table_size > d1)
-//      {
-//        i++;
-//        d1 += pow(c_vocabulary->idx_to_data(i).cn, power) / train_words_pow;
-//      }
-//      if (i >= c_vocabulary->size())
-//        i = c_vocabulary->size() - 1;
-//    }
-//  } // method-end
+  // функция инициализации распределения, имитирующего шум, для метода оптимизации negative sampling  -- для словаря контекстов
+  void InitUnigramTable_c()
+  {
+    double train_words_pow = 0;
+    double d1, power = 0.75;
+    table = (word_index_t *)malloc(table_size * sizeof(word_index_t));
+    // вычисляем нормирующую сумму  (за слагаемое берется абсолютная частота слова/контекста в степени 3/4)
+    for (size_t a = 0; a < c_vocabulary->size(); ++a)
+      train_words_pow += pow(c_vocabulary->idx_to_data(a).cn, power);
+    // заполняем таблицу распределения, имитирующего шум
+    size_t i = 0;
+    d1 = pow(c_vocabulary->idx_to_data(i).cn, power) / train_words_pow;
+    for (size_t a = 0; a < table_size; ++a)
+    {
+      table[a] = i;
+      if (a / (double)table_size > d1)
+      {
+        i++;
+        d1 += pow(c_vocabulary->idx_to_data(i).cn, power) / train_words_pow;
+      }
+      if (i >= c_vocabulary->size())
+        i = c_vocabulary->size() - 1;
+    }
+  } // method-end
 private:
   uint64_t train_words = 0;
   uint64_t word_count_actual = 0;
   std::chrono::steady_clock::time_point start_learning_tp;
+  // срок окончания обучения (см. set_deadline) и признак его наступления
+  bool has_deadline = false;
+  std::chrono::steady_clock::time_point deadline_tp;
+  std::atomic<bool> time_is_up{false};
+  // признак досрочного завершения обучения (см. request_stop)
+  std::atomic<bool> stop_requested{false};
+  // состояние потоков обучения для внешнего наблюдения (см. status); выровнено по кэш-линии, чтобы потоки не мешали друг другу
+  struct alignas(64) ThreadStatus
+  {
+    std::atomic<uint64_t> words{0};
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<uint64_t> lookahead{0};
+  };
+  std::unique_ptr<ThreadStatus[]> thread_status;
+  size_t thread_status_count = 0;
+  std::atomic<float> published_alpha{0};
+  std::atomic<float> published_progress{0};
+  std::atomic<double> published_loss{-1};
+  // выборочное отслеживание функции потерь (см. set_loss_sampling): суммы по эпохам и количество потоков, завершивших эпоху
+  struct EpochLoss
+  {
+    double sum = 0;
+    uint64_t count = 0;
+    size_t threads = 0;
+  };
+  size_t loss_sampling = 0;
+  float early_stop_improvement = 0;
+  std::vector<EpochLoss> epoch_losses;
+  std::mutex epoch_losses_mtx;
+  std::atomic<bool> early_stopped_flag{false};
+  // подготовка состояния для threads_count потоков (до запуска потоков обучения)
+  void reset_status(size_t threads_count)
+  {
+    thread_status.reset(new ThreadStatus[threads_count]);
+    thread_status_count = threads_count;
+    published_alpha = alpha;
+    published_progress = 0;
+    published_loss = -1;
+    epoch_losses.assign(epoch_count, EpochLoss());
+  }
+  // учет функции потерь, накопленной потоком за эпоху epoch; поток, последним завершивший эпоху, выводит её среднее значение
+  // и проверяет критерий досрочного завершения обучения
+  void finish_epoch_loss(size_t epoch, const LossAccumulator& loss)
+  {
+    std::lock_guard<std::mutex> lock(epoch_losses_mtx);
+    auto& current = epoch_losses[epoch];
+    current.sum += loss.sum;
+    current.count += loss.count;
+    if (++current.threads < thread_status_count || current.count == 0) return;
+    const double mean = current.sum / current.count;
+    published_loss.store(mean, std::memory_order_relaxed);
+    printf("\nEpoch %lu: sampled loss %.5f (%lu predictions)", epoch + 1, mean, current.count);
+    if (epoch > 0 && epoch_losses[epoch - 1].count > 0)
+    {
+      const double previous = epoch_losses[epoch - 1].sum / epoch_losses[epoch - 1].count;
+      const double improvement = (previous - mean) / previous;
+      printf(", improvement %.2f%%", improvement * 100);
+      if (early_stop_improvement > 0 && improvement < early_stop_improvement && epoch + 1 < epoch_count)
+      {
+        printf("\nEarly stopping: improvement is below %.2f%%", early_stop_improvement * 100);
+        early_stopped_flag = true;
+        stop_requested = true;
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+  } // method-end
+  // копия матрицы эмбеддингов во float (см. embeddings)
+  std::vector<float> embeddings_copy;
+  // количество горячих строк в каждой весовой матрице и периодичность их синхронизации
+  size_t hot_rows_count = 0;
+  size_t hot_rows_flush_interval = 1;
+
+  // выбор горячих строк и создание их частных копий для текущего потока
+  // словарь упорядочен по убыванию частоты, поэтому горячими являются первые строки матрицы syn0 и (при negative sampling) syn1;
+  // при hierarchical softmax строки syn1 соответствуют узлам дерева Хаффмана, и горячими являются последние строки (узлы у вершины)
+  void init_hot_rows(HotRows& hot_rows)
+  {
+    hot_rows.flush_interval = hot_rows_flush_interval;
+    const size_t in_rows = std::min(hot_rows_count, in_vocabulary->size());
+    hot_rows.in.init(0, in_rows, layer1_size, weights_element_size(precision));
+    if (optimization_algo == loaHierarchicalSoftmax)
+    {
+      const size_t nodes = (out_vocabulary->size() > 1) ? out_vocabulary->size() - 1 : 0;
+      const size_t out_rows = std::min(hot_rows_count, nodes);
+      hot_rows.out.init(nodes - out_rows, out_rows, layer1_size, weights_element_size(precision));
+    }
+    else
+      hot_rows.out.init(0, std::min(hot_rows_count, out_vocabulary->size()), layer1_size, weights_element_size(precision));
+    if ( hot_rows.enabled() )
+      sync_hot_rows(hot_rows);
+  }
+  // синхронизация частных копий горячих строк с общими весовыми матрицами
+  void sync_hot_rows(HotRows& hot_rows)
+  {
+    profile_section(psComputeHotRowsSync);
+    switch (precision)
+    {
+      case wpFloat32:
+        hot_rows.in.sync(syn0);
+        hot_rows.out.sync(syn1);
+        break;
+      case wpBFloat16:
+        hot_rows.in.sync(reinterpret_cast<bf16_t*>(syn0));
+        hot_rows.out.sync(reinterpret_cast<bf16_t*>(syn1));
+        break;
+      case wpFloat16:
+        hot_rows.in.sync(reinterpret_cast<fp16_t*>(syn0));
+        hot_rows.out.sync(reinterpret_cast<fp16_t*>(syn1));
+        break;
+    }
+  }
+
+  // инициализация строк [row_begin; row_end) весовой матрицы: случайными значениями (как в оригинальном word2vec) либо нулями
+  void init_rows(float *weight_matrix, size_t row_begin, size_t row_end, bool random)
+  {
+    switch (precision)
+    {
+      case wpFloat32:  init_rows_typed(weight_matrix, row_begin, row_end, random); break;
+      case wpBFloat16: init_rows_typed(reinterpret_cast<bf16_t*>(weight_matrix), row_begin, row_end, random); break;
+      case wpFloat16:  init_rows_typed(reinterpret_cast<fp16_t*>(weight_matrix), row_begin, row_end, random); break;
+    }
+  }
+  template <typename T>
+  void init_rows_typed(T *weight_matrix, size_t row_begin, size_t row_end, bool random)
+  {
+    if (!random)
+    {
+      for (size_t e = row_begin * layer1_size, eEnd = row_end * layer1_size; e < eEnd; ++e)
+        store_nearest(weight_matrix[e], 0.0f);
+      return;
+    }
+    // оригинальный word2vec заполняет матрицу одной последовательностью линейного конгруэнтного генератора;
+    // чтобы получить в точности те же значения, генератор "перематывается" к первому элементу диапазона
+    unsigned long long next_random = lcg_skip(1, row_begin * layer1_size);
+    for (size_t a = row_begin; a < row_end; ++a)
+      for (size_t b = 0; b < layer1_size; ++b)
+      {
+        next_random = next_random * (unsigned long long)25214903917 + 11;
+        store_nearest(weight_matrix[a * layer1_size + b], (((next_random & 0xFFFF) / (float)65536) - 0.5) / layer1_size);
+      }
+  }
+  // состояние генератора x' = x * 25214903917 + 11 после n шагов из состояния x (за O(log n) операций)
+  static unsigned long long lcg_skip(unsigned long long x, uint64_t n)
+  {
+    unsigned long long mul = 1, add = 0;                   // накопленное преобразование x -> mul * x + add
+    unsigned long long cur_mul = 25214903917, cur_add = 11; // преобразование для 2^k шагов
+    while (n > 0)
+    {
+      if (n & 1)
+      {
+        mul = mul * cur_mul;
+        add = add * cur_mul + cur_add;
+      }
+      cur_add = (cur_mul + 1) * cur_add;
+      cur_mul = cur_mul * cur_mul;
+      n >>= 1;
+    }
+    return mul * x + add;
+  }
 
+  // получение строки весовой матрицы во float (независимо от формата хранения)
+  void read_row(const float *weight_matrix, size_t row, float *dst) const
+  {
+    switch (precision)
+    {
+      case wpFloat32:  load_row(dst, weight_matrix + row * layer1_size, layer1_size); break;
+      case wpBFloat16: load_row(dst, reinterpret_cast<const bf16_t*>(weight_matrix) + row * layer1_size, layer1_size); break;
+      case wpFloat16:  load_row(dst, reinterpret_cast<const fp16_t*>(weight_matrix) + row * layer1_size, layer1_size); break;
+    }
+  }
+  // запись float-строки в весовую матрицу (с округлением к ближайшему для 16-битных форматов)
+  void write_row(float *weight_matrix, size_t row, const float *src)
+  {
+    switch (precision)
+    {
+      case wpFloat32:  write_row_typed(weight_matrix, row, src); break;
+      case wpBFloat16: write_row_typed(reinterpret_cast<bf16_t*>(weight_matrix), row, src); break;
+      case wpFloat16:  write_row_typed(reinterpret_cast<fp16_t*>(weight_matrix), row, src); break;
+    }
+  }
+  template <typename T>
+  void write_row_typed(T *weight_matrix, size_t row, const float *src)
+  {
+    for (size_t b = 0; b < layer1_size; ++b)
+      store_nearest(weight_matrix[row * layer1_size + b], src[b]);
+  }
   void saveEmbeddingsBin_helper(FILE *fo, std::shared_ptr< CustomVocabulary > vocabulary, float *weight_matrix) const
   {
+    std::vector<float> row(layer1_size);
     for (size_t a = 0; a < vocabulary->size(); ++a)
     {
       fprintf(fo, "%s ", vocabulary->idx_to_data(a).word.c_str());
+      read_row(weight_matrix, a, row.data());
       for (size_t b = 0; b < layer1_size; ++b)
-        fwrite(&weight_matrix[a * layer1_size + b], sizeof(float), 1, fo);
+        fwrite(&row[b], sizeof(float), 1, fo);
       fprintf(fo, "\n");
     }
   }
   void saveEmbeddingsTxt_helper(FILE *fo, std::shared_ptr< CustomVocabulary > vocabulary, float *weight_matrix) const
   {
+    std::vector<float> row(layer1_size);
     for (size_t a = 0; a < vocabulary->size(); ++a)
     {
       fprintf(fo, "%s", vocabulary->idx_to_data(a).word.c_str());
+      read_row(weight_matrix, a, row.data());
       for (size_t b = 0; b < layer1_size; ++b)
-        fprintf(fo, " %lf", weight_matrix[a * layer1_size + b]);
+        fprintf(fo, " %lf", row[b]);
       fprintf(fo, "\n");
     }
   }
@@ -8,6 +8,34 @@
 #include <numeric>
 #include <list>
 #include <iostream>
+#include <cstdint>
+
+
+// тип индекса слова/контекста в словаре, используемый во всем тракте обучения (предложения, обучающие примеры, таблица шума,
+// пути в дереве Хаффмана); 32-битный индекс вдвое сокращает объем памяти, занимаемой предложениями и обучающими примерами
+// для словарей, не умещающихся в 32-битный индекс, w2vxx собирается с макросом W2V_INDEX64 (make INDEX64=1)
+#ifdef W2V_INDEX64
+typedef uint64_t word_index_t;
+#else
+typedef uint32_t word_index_t;
+#endif
+
+// признак отсутствия слова в словаре (результат word_to_idx)
+const word_index_t NO_WORD_INDEX = std::numeric_limits<word_index_t>::max();
+
+
+// объем блока динамической памяти, выделяемого под n байт (с учетом заголовка блока и выравнивания, как у распределителя glibc);
+// используется при расчете потребности в памяти (-dry-run)
+inline uint64_t heap_block_bytes(uint64_t n)
+{
+  if (n == 0) return 0;
+  return std::max<uint64_t>(32, (n + 8 + 15) & ~static_cast<uint64_t>(15));
+}
+// объем динамической памяти, занимаемой строкой заданной емкости (короткие строки хранятся в самом объекте std::string)
+inline uint64_t string_heap_bytes(size_t capacity)
+{
+  return (capacity > std::string().capacity()) ? heap_block_bytes(capacity + 1) : 0;
+}
 
 
 // данные словаря
@@ -22,8 +50,8 @@ struct VocabularyData
   // код Хаффмана, записанный в float-формате
   std::vector<float> huffman_code_float;
   // путь в дереве Хаффмана (от корня к листу), соответствующий данному слову (для алгоритма Hierarchical Softmax)
-  // элементами пути являются индексы внутренних узлов в дереве Хаффмана
-  std::vector<int> huffman_path;
+  // элементами пути являются индексы внутренних узлов в дереве Хаффмана (сам лист в путь не входит)
+  std::vector<word_index_t> huffman_path;
   // конструктор
   VocabularyData(const std::string& theWord, const uint64_t theFrequency)
   : word(theWord), cn(theFrequency)
@@ -44,7 +72,8 @@ public:
   {
   }
   // получение индекса в словаре по тексту слова/контекста
-  virtual size_t word_to_idx(const std::string& word) const = 0;
+  // (NO_WORD_INDEX, если слова нет в словаре)
+  virtual word_index_t word_to_idx(const std::string& word) const = 0;
   // получение данных словаря по индексу
   inline const VocabularyData& idx_to_data(size_t word_idx) const
   {
@@ -65,22 +94,86 @@ public:
                             static_cast<uint64_t>(0),
                             [](const uint64_t& sum, const VocabularyData& r) -> uint64_t { return sum + r.cn; } );
   }
+  // объем памяти, занимаемой словарем (записи, строки слов, коды и пути в дереве Хаффмана, если оно построено)
+  virtual uint64_t memory_bytes() const
+  {
+    uint64_t bytes = heap_block_bytes(vocabulary.capacity() * sizeof(VocabularyData));
+    for (auto&& r : vocabulary)
+      bytes += string_heap_bytes(r.word.capacity()) + string_heap_bytes(r.huffman_code.capacity())
+               + heap_block_bytes(r.huffman_code_float.capacity() * sizeof(float)) + heap_block_bytes(r.huffman_path.capacity() * sizeof(word_index_t));
+    return bytes;
+  } // method-end
+  // объем памяти, которую займут коды и пути в дереве Хаффмана (расчет без заполнения кодов и путей: дерево строится лишь во временных массивах, см. buildHuffmanTree),
+  // и объем временных массивов, используемых при построении дерева (transient_bytes)
+  uint64_t huffman_memory_bytes(uint64_t& transient_bytes) const
+  {
+    transient_bytes = 0;
+    if (size() < 2) return 0;
+    std::vector<bool> binary;
+    std::vector<size_t> parent;
+    huffman_links(binary, parent);
+    transient_bytes = heap_block_bytes(binary.size() * sizeof(uint64_t)) + heap_block_bytes(binary.size() / 8 + 8) + heap_block_bytes(parent.size() * sizeof(size_t));
+    uint64_t bytes = 0;
+    for (size_t idx = 0; idx < size(); ++idx)
+    {
+      size_t code_len = 1;
+      for (size_t node = parent[idx]; node != size() * 2 - 2; node = parent[node])
+        ++code_len;
+      bytes += string_heap_bytes(code_len) + heap_block_bytes(code_len * sizeof(float)) + heap_block_bytes(code_len * sizeof(word_index_t));
+    }
+    return bytes;
+  } // method-end
   // построение дерева Хаффмана, вычисление кодов Хаффмана и путей для каждого слова/контекста
   // !!! изнчально предполагается, что вектор vocabulary отсортирован по убыванию cn
   void buildHuffmanTree()
   {
     if (size() == 0) return;
+    std::vector<bool> binary;
+    std::vector<size_t> parent;
+    huffman_links(binary, parent);
+    // присваиваем Хаффман-коды каждому слову/контексту словаря
+    for (size_t idx = 0; idx < size(); ++idx)
+    {
+      size_t idx_in_path = idx;  // индекс очередного узла в пути от листу к корню дерева
+      size_t path_len = 0;       // накопленная к настоящему времени длина пути (количество дуг)
+      std::list<char> code;          // накопитель кода Хаффмана
+      std::list<size_t> path_indexes;   // накопитель пути в дереве Хаффмана (в итоге здесь окажется путь от корня к родителю листа)
+      while (true)
+      {
+        code.push_front( binary[idx_in_path] ? '1' : '0' );
+        path_len++;
+        idx_in_path = parent[idx_in_path];
+        if (idx_in_path == size() * 2 - 2)
+          break;
+        path_indexes.push_front(idx_in_path);
+      }
+      path_indexes.push_front( size() * 2 - 2 ); // вершину дерева добавляем в начало пути
+      vocabulary[idx].huffman_code.resize( code.size() );
+      std::copy( code.cbegin(), code.cend(), vocabulary[idx].huffman_code.begin() );
+      vocabulary[idx].huffman_code_float.resize( code.size() );
+      std::transform( code.cbegin(), code.cend(), vocabulary[idx].huffman_code_float.begin(), [](const char c) -> float {return (c == '1') ? 1.0 : 0.0;} );
+      // индексы в пути переиндексируются таким образом, чтобы индексация промежуточных вершин начиналась с 0
+      vocabulary[idx].huffman_path.resize( path_indexes.size() );
+      std::transform( path_indexes.cbegin(), path_indexes.cend(), vocabulary[idx].huffman_path.begin(), [this](const size_t curIdx) -> word_index_t {return curIdx - size();} );
+    }
+  } // method-end
+protected:
+  std::vector<VocabularyData> vocabulary;
+  // построение дерева Хаффмана: для каждого узла (листья -- записи словаря, далее -- промежуточные узлы, последний -- вершина)
+  // вычисляются родительский узел (parent) и метка дуги, ведущей к родителю (binary)
+  void huffman_links(std::vector<bool>& binary, std::vector<size_t>& parent) const
+  {
     // в векторе count хранится таблица частот для всего дерева
     // начало вектора соответствует листьям (кодируемым элементам, т.е. словам/контекстам); далее идут промежуточные узлы дерева; вершине дерева будет соответствовать последний элемент вектора
     std::vector<uint64_t> count( size()*2-1, std::numeric_limits<uint64_t>::max() );
     std::transform(vocabulary.begin(), vocabulary.end(), count.begin(), [](const VocabularyData& data) -> uint64_t {return data.cn;});
     // в векторе binary хранится метка (0 или 1), присвоенная дуге, ведущей к родителю данного узла
-    std::vector<bool> binary( size()*2-1, false );
+    binary.assign( size()*2-1, false );
     // в векторе parent хранится индекс узла, родительского по отношению к данному
-    std::vector<size_t> parent( size()*2-1 );
+    parent.assign( size()*2-1, 0 );
     // построение дерева
-    int pos1 = size() - 1;     // индекс, пробегающий листья дерева, в ходе его построения
-    int pos2 = size();         // индекс, пробегающий промежуточные узлы дерева, в ходе его построения
+    int64_t pos1 = size() - 1;     // индекс, пробегающий листья дерева, в ходе его построения
+    int64_t pos2 = size();         // индекс, пробегающий промежуточные узлы дерева, в ходе его построения
     for (size_t idx = 0; idx < (size() - 1); ++idx)
     {
       // лямбда-функция для поиска очередного узла с наименьшей частотой
@@ -111,34 +204,15 @@ public:
       parent[min2i] = size() + idx;
       binary[min2i] = true;
     }
-    // присваиваем Хаффман-коды каждому слову/контексту словаря
-    for (size_t idx = 0; idx < size(); ++idx)
-    {
-      size_t idx_in_path = idx;  // индекс очередного узла в пути от листу к корню дерева
-      size_t path_len = 0;       // накопленная к настоящему времени длина пути (количество дуг)
-      std::list<char> code;          // накопитель кода Хаффмана
-      std::list<int> path_indexes;   // накопитель пути в дереве Хаффмана (в итоге здесь окажется путь от корня к листу)
-      while (true)
-      {
-        code.push_front( binary[idx_in_path] ? '1' : '0' );
-        path_indexes.push_front(idx_in_path);
-        path_len++;
-        idx_in_path = parent[idx_in_path];
-        if (idx_in_path == size() * 2 - 2)
-          break;
-      }
-      path_indexes.push_front( size() * 2 - 2 ); // вершину дерева добавляем в начало пути
-      vocabulary[idx].huffman_code.resize( code.size() );
-      std::copy( code.cbegin(), code.cend(), vocabulary[idx].huffman_code.begin() );
-      vocabulary[idx].huffman_code_float.resize( code.size() );
-      std::transform( code.cbegin(), code.cend(), vocabulary[idx].huffman_code_float.begin(), [](const char c) -> float {return (c == '1') ? 1.0 : 0.0;} );
-      // индексы в пути переиндексируются таким образом, чтобы листья имели отрицательные индексы, а промежуточные вершины неотрицательные (и их индексация начиналась с 0)
-      vocabulary[idx].huffman_path.resize( path_indexes.size() );
-      std::transform( path_indexes.cbegin(), path_indexes.cend(), vocabulary[idx].huffman_path.begin(), [this](const int curIdx) -> int {return curIdx - size();} );
-    }
   } // method-end
-protected:
-  std::vector<VocabularyData> vocabulary;
+  // проверка того, что индексы всех записей словаря (и узлов дерева Хаффмана) представимы типом word_index_t
+  bool check_index_range(const std::string& source) const
+  {
+    if (size() < NO_WORD_INDEX) return true;
+    std::cerr << "Vocabulary is too large for " << sizeof(word_index_t) * 8 << "-bit word indexes (" << size() << " records): " << source << std::endl;
+    std::cerr << "Rebuild w2vxx with 64-bit indexes (make INDEX64=1)" << std::endl;
+    return false;
+  }
 };
 
 
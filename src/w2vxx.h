@@ -0,0 +1,25 @@
+#ifndef W2VXX_H_
+#define W2VXX_H_
+
+// Заголовочный файл для использования w2vxx как библиотеки (обучение на корпусе, находящемся в памяти, без файлов):
+//
+//   std::vector<std::string> tokens = ...;   // токенизированный корпус, "</s>" -- конец предложения
+//   auto v = std::make_shared<OriginalWord2VecVocabulary>();
+//   v->build(tokens.begin(), tokens.end(), 5);
+//   std::vector<word_index_t> ids = InMemoryLearningExampleProvider::encode(*v, tokens.begin(), tokens.end());
+//   auto lep = std::make_shared<InMemoryLearningExampleProvider>(ids.data(), ids.size(), threads, 5, 1e-3, v);
+//   SgTrainer_Mikolov trainer(lep, v, v, 100, 5, 0.025, "ns", 5);
+//   trainer.init_net(threads);
+//   trainer.train(threads);
+//   Span<const float> matrix = trainer.embeddings();   // v->size() строк по trainer.embedding_size() чисел
+//
+// Если корпус уже представлен индексами, словарь может быть построен вызывающей стороной (merge + sort_by_frequency);
+// если сумма частот словаря не совпадает с длиной корпуса, её следует передать в set_train_words.
+// Сборка: -std=c++17 -pthread.
+
+#include "original_word2vec_vocabulary.h"
+#include "in_memory_le_provider.h"
+#include "cbow_trainer_mikolov.h"
+#include "sg_trainer_mikolov.h"
+
+#endif /* W2VXX_H_ */
@@ -0,0 +1,374 @@
+#ifndef WEIGHTS_MEMORY_H_
+#define WEIGHTS_MEMORY_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <sys/syscall.h>
+  #include <sys/mman.h>
+#endif
+
+#ifdef _MSC_VER
+  #define posix_memalign(p, a, s) (((*(p)) = _aligned_malloc((s), (a))), *(p) ? 0 : errno)
+  #define free_aligned(p) _aligned_free((p))
+#else
+  #define free_aligned(p) free((p))
+#endif
+
+
+// Размещение весовых матриц в памяти (в т.ч. на огромных страницах) и привязка потоков к ядрам.
+// На многопроцессорных (NUMA) системах страница физической памяти выделяется на том узле, где к ней впервые обратились
+// (first-touch), поэтому матрицы инициализируются параллельно теми же (привязанными) потоками, что ведут обучение;
+// либо страницы явно чередуются между узлами (interleave). Реализация опирается только на системные вызовы Linux (без libnuma);
+// на прочих платформах соответствующие настройки игнорируются.
+// Для обучения моделей, весовые матрицы которых не помещаются в оперативную память (out-of-core), матрицы размещаются
+// в отображенных в память файлах (например, на локальном NVMe): частотная "голова" словаря (первые строки матрицы) закрепляется
+// в памяти, а "хвост" подгружается с диска по требованию и вытесняется системой при нехватке памяти.
+
+
+// политика привязки потоков к ядрам
+enum ThreadPinning
+{
+  tpNone,       // без привязки
+  tpCompact,    // потоки плотно заполняют ядра первого NUMA-узла, затем второго и т.д.
+  tpScatter     // потоки по очереди распределяются между NUMA-узлами
+};
+
+// политика размещения страниц весовых матриц
+enum NumaPolicy
+{
+  npFirstTouch, // страница достается узлу потока, первым обратившегося к ней (при параллельной инициализации -- равномерно)
+  npInterleave  // страницы чередуются между всеми узлами
+};
+
+// использование огромных страниц (huge pages) для весовых матриц;
+// при случайном доступе к строкам многогигабайтных матриц это резко сокращает промахи TLB
+enum HugePages
+{
+  hpNone,       // обычные страницы
+  hpTransparent,// прозрачные огромные страницы (madvise MADV_HUGEPAGE)
+  hpExplicit    // явно зарезервированные огромные страницы (mmap MAP_HUGETLB), при нехватке -- прозрачные
+};
+
+struct MemoryPlacement
+{
+  ThreadPinning pinning = tpNone;
+  NumaPolicy numa = npFirstTouch;
+  HugePages huge_pages = hpNone;
+  // каталог для файлов весовых матриц (пустая строка -- матрицы в оперативной памяти)
+  std::string weights_dir;
+  // количество строк каждой матрицы, закрепляемых в памяти при размещении в файлах
+  size_t resident_rows = 0;
+  bool file_backed() const
+  {
+    return !weights_dir.empty();
+  }
+  // разбор значений параметров командной строки (false, если значение не распознано)
+  bool parse(const std::string& pinning_str, const std::string& numa_str, const std::string& huge_pages_str)
+  {
+    if (huge_pages_str == "none") huge_pages = hpNone;
+    else if (huge_pages_str == "thp") huge_pages = hpTransparent;
+    else if (huge_pages_str == "explicit") huge_pages = hpExplicit;
+    else return false;
+    if (pinning_str == "none") pinning = tpNone;
+    else if (pinning_str == "compact") pinning = tpCompact;
+    else if (pinning_str == "scatter") pinning = tpScatter;
+    else return false;
+    if (numa_str == "first-touch") numa = npFirstTouch;
+    else if (numa_str == "interleave") numa = npInterleave;
+    else return false;
+    return true;
+  }
+};
+
+
+namespace weights_memory_internal
+{
+  // разбор списка вида "0-3,8,10-11" (формат sysfs)
+  inline std::vector<int> parse_list(const std::string& list)
+  {
+    std::vector<int> result;
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+      size_t comma = list.find(',', pos);
+      if (comma == std::string::npos) comma = list.size();
+      std::string item = list.substr(pos, comma - pos);
+      size_t dash = item.find('-');
+      try
+      {
+        int first = std::stoi(item.substr(0, dash));
+        int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+        for (int i = first; i <= last; ++i)
+          result.push_back(i);
+      } catch (...) {}
+      pos = comma + 1;
+    }
+    return result;
+  }
+  inline std::string read_line(const std::string& filename)
+  {
+    std::ifstream ifs(filename);
+    std::string line;
+    std::getline(ifs, line);
+    return line;
+  }
+  // NUMA-узлы системы
+  inline std::vector<int> numa_nodes()
+  {
+    auto nodes = parse_list( read_line("/sys/devices/system/node/online") );
+    if (nodes.empty()) nodes.push_back(0);
+    return nodes;
+  }
+  // ядра, доступные процессу, в порядке привязки потоков
+  inline std::vector<int> cpus_for_pinning(ThreadPinning pinning)
+  {
+    std::vector<int> result;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return result;
+    // доступные ядра каждого узла (нумерация ядер может чередоваться между узлами: node0 = 0,2,4..., node1 = 1,3,5...)
+    std::vector< std::vector<int> > per_node;
+    for (int node : numa_nodes())
+    {
+      std::vector<int> node_cpus;
+      for (int cpu : parse_list( read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist") ))
+        if (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+          node_cpus.push_back(cpu);
+      if (!node_cpus.empty())
+        per_node.push_back(node_cpus);
+    }
+    if (pinning == tpCompact)
+    {
+      // все ядра первого узла, затем второго и т.д.
+      for (auto&& node_cpus : per_node)
+        result.insert(result.end(), node_cpus.begin(), node_cpus.end());
+    }
+    else if (pinning == tpScatter)
+    {
+      // по одному ядру с каждого узла, затем следующему и т.д.
+      for (size_t i = 0; !per_node.empty(); ++i)
+      {
+        bool added = false;
+        for (auto&& node_cpus : per_node)
+          if (i < node_cpus.size())
+          {
+            result.push_back(node_cpus[i]);
+            added = true;
+          }
+        if (!added) break;
+      }
+    }
+    // сведений о NUMA-узлах нет -- ядра в порядке номеров
+    if (result.empty())
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &allowed))
+          result.push_back(cpu);
+#endif
+    return result;
+  }
+} // namespace weights_memory_internal
+
+
+// привязка текущего потока к ядру в соответствии с его порядковым номером
+inline void pin_current_thread(size_t thread_idx, ThreadPinning pinning)
+{
+  if (pinning == tpNone) return;
+#ifdef __linux__
+  static const std::vector<int> cpus = weights_memory_internal::cpus_for_pinning(pinning);
+  if (cpus.empty()) return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpus[thread_idx % cpus.size()], &cpuset);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+    std::cerr << "Can't pin thread " << thread_idx << " to CPU " << cpus[thread_idx % cpus.size()] << std::endl;
+#endif
+}
+
+
+// блок памяти под весовую матрицу
+// память не инициализируется: первое обращение к страницам определяет их размещение на NUMA-узлах
+class WeightsBlock
+{
+public:
+  WeightsBlock()
+  {
+  }
+  WeightsBlock(const WeightsBlock&) = delete;
+  WeightsBlock& operator=(const WeightsBlock&) = delete;
+  ~WeightsBlock()
+  {
+    release();
+  }
+  // выделение памяти (false в случае неудачи)
+  bool allocate(size_t bytes, const MemoryPlacement& placement)
+  {
+    release();
+    if (bytes == 0) bytes = 1;
+#ifdef __linux__
+    // явно зарезервированные огромные страницы (hugetlbfs); при их нехватке -- прозрачные огромные страницы
+    if (placement.huge_pages == hpExplicit)
+    {
+      size_t rounded = allocation_bytes(bytes, placement);
+      void *p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED)
+      {
+        ptr = p;
+        mapped_bytes = rounded;
+      }
+      else
+        std::cerr << "Explicit huge pages are not available (see /proc/sys/vm/nr_hugepages), falling back to transparent huge pages" << std::endl;
+    }
+#endif
+    if (!ptr)
+    {
+      // для огромных страниц блок выравнивается и дополняется до их границы, чтобы madvise не затрагивал чужую память
+      const bool huge = (placement.huge_pages != hpNone);
+      const size_t alignment = huge ? HUGE_PAGE_SIZE : 128;
+      const size_t alloc_bytes = allocation_bytes(bytes, placement);
+      if (posix_memalign(&ptr, alignment, alloc_bytes) != 0)
+      {
+        ptr = nullptr;
+        return false;
+      }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+      if (huge && madvise(ptr, alloc_bytes, MADV_HUGEPAGE) != 0)
+        std::cerr << "Transparent huge pages are not available" << std::endl;
+#endif
+    }
+    apply_numa_policy(bytes, placement);
+    return true;
+  }
+  // размещение блока в файле name каталога placement.weights_dir, отображенном в память (out-of-core обучение);
+  // байты [pinned_offset; pinned_offset + pinned_bytes) закрепляются в памяти (mlock), к остальным страницам система
+  // обращается по требованию, без упреждающего чтения (доступ к строкам случайный);
+  // файл сразу удаляется из каталога, место на диске освобождается при завершении процесса;
+  // новый блок заполнен нулями (false в случае неудачи)
+  bool map_file(size_t bytes, const MemoryPlacement& placement, const std::string& name, size_t pinned_offset, size_t pinned_bytes)
+  {
+    release();
+    if (bytes == 0) bytes = 1;
+#ifdef __linux__
+    const std::string filename = placement.weights_dir + "/" + name + "." + std::to_string(getpid());
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+      std::cerr << "Can't create weights file " << filename << ": " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    unlink(filename.c_str());
+    // место на диске резервируется сразу: его нехватка обнаруживается здесь, а не сигналом SIGBUS посреди обучения
+    const int rc = posix_fallocate(fd, 0, bytes);
+    if (rc != 0)
+    {
+      std::cerr << "Can't reserve " << bytes << " bytes for weights file " << filename << ": " << std::strerror(rc) << std::endl;
+      close(fd);
+      return false;
+    }
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+      std::cerr << "Can't map weights file " << filename << ": " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    ptr = p;
+    mapped_bytes = bytes;
+    file_mapped = true;
+    if (placement.huge_pages != hpNone)
+      std::cerr << "Huge pages are not used for file-backed weights" << std::endl;
+    madvise(ptr, bytes, MADV_RANDOM);
+    // закрепляемый диапазон расширяется до границ страниц
+    pinned_bytes = std::min(pinned_bytes, bytes - std::min(pinned_offset, bytes));
+    if (pinned_bytes > 0)
+    {
+      const uintptr_t page = sysconf(_SC_PAGESIZE);
+      const uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + pinned_offset) & ~(page - 1);
+      const uintptr_t end = reinterpret_cast<uintptr_t>(ptr) + pinned_offset + pinned_bytes;
+      madvise(reinterpret_cast<void*>(begin), end - begin, MADV_NORMAL);
+      if (mlock(reinterpret_cast<void*>(begin), end - begin) != 0)
+      {
+        std::cerr << "Can't lock " << (end - begin) << " bytes of " << name << " in memory (" << std::strerror(errno)
+                  << "; see ulimit -l), relying on the page cache" << std::endl;
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+      }
+    }
+    apply_numa_policy(bytes, placement);
+    return true;
+#else
+    std::cerr << "File-backed weights are supported only on Linux" << std::endl;
+    return false;
+#endif
+  }
+  float* data() const
+  {
+    return static_cast<float*>(ptr);
+  }
+  // объем памяти, фактически занимаемой блоком из bytes байт при размещении в оперативной памяти (allocate)
+  static size_t allocation_bytes(size_t bytes, const MemoryPlacement& placement)
+  {
+    if (bytes == 0) bytes = 1;
+    return (placement.huge_pages != hpNone) ? ((bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)) : bytes;
+  }
+  // блок размещен в файле (и, следовательно, изначально заполнен нулями)
+  bool is_file_mapped() const
+  {
+    return file_mapped;
+  }
+private:
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+  void *ptr = nullptr;
+  size_t mapped_bytes = 0;   // ненулевое значение -- память получена через mmap
+  bool file_mapped = false;  // память отображена на файл
+
+  void release()
+  {
+    if (!ptr) return;
+#ifdef __linux__
+    if (mapped_bytes > 0)
+      munmap(ptr, mapped_bytes);
+    else
+#endif
+      free_aligned(ptr);
+    ptr = nullptr;
+    mapped_bytes = 0;
+    file_mapped = false;
+  }
+  void apply_numa_policy(size_t bytes, const MemoryPlacement& placement)
+  {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (placement.numa != npInterleave) return;
+    const int MPOL_INTERLEAVE_ = 3;
+    auto nodes = weights_memory_internal::numa_nodes();
+    if (nodes.size() < 2) return;
+    unsigned long nodemask[16] = {0};
+    for (int node : nodes)
+      if (node < 1024)
+        nodemask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    // mbind требует выравнивания адреса по границе страницы; захватываем целые страницы внутри блока
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + bytes) & ~(page - 1);
+    if (end > begin)
+      if (syscall(SYS_mbind, begin, end - begin, MPOL_INTERLEAVE_, nodemask, 1024 + 1, 0) != 0)
+        std::cerr << "NUMA interleave policy can't be applied to weights" << std::endl;
+#endif
+  }
+}; // class-decl-end
+
+
+#endif /* WEIGHTS_MEMORY_H_ */
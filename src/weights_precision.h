@@ -0,0 +1,265 @@
+#ifndef WEIGHTS_PRECISION_H_
+#define WEIGHTS_PRECISION_H_
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+#if defined(__F16C__)
+  #include <immintrin.h>
+#endif
+
+
+// Хранение весовых матриц с пониженной точностью (bfloat16 либо IEEE fp16).
+// Вычисления всегда ведутся во float: элементы строк преобразуются при чтении, а при записи округляются стохастически
+// (вероятность округления вверх пропорциональна отброшенной части), чтобы малые обновления не терялись систематически.
+// Ядра (скалярное произведение, axpy и т.п.) для float в точности повторяют исходные вычисления word2vec;
+// для 16-битных типов -- перегружены.
+// Преобразования fp16 выполняются инструкциями F16C, если компилятор их поддерживает (например, -march=native),
+// иначе -- программно; преобразование bfloat16 сводится к сдвигу и векторизуется компилятором.
+
+
+// формат хранения весов
+enum WeightsPrecision
+{
+  wpFloat32,
+  wpBFloat16,
+  wpFloat16
+};
+
+inline bool parse_weights_precision(const std::string& str, WeightsPrecision& precision)
+{
+  if (str == "fp32") precision = wpFloat32;
+  else if (str == "bf16") precision = wpBFloat16;
+  else if (str == "fp16") precision = wpFloat16;
+  else return false;
+  return true;
+}
+
+inline size_t weights_element_size(WeightsPrecision precision)
+{
+  return (precision == wpFloat32) ? sizeof(float) : sizeof(uint16_t);
+}
+
+struct bf16_t { uint16_t bits; };
+struct fp16_t { uint16_t bits; };
+
+
+namespace weights_precision_internal
+{
+  // генератор случайных чисел для стохастического округления (у каждого потока свой)
+  inline thread_local uint64_t rounding_state = 0x9E3779B97F4A7C15ULL;
+  inline uint32_t next_random()
+  {
+    uint64_t x = rounding_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    rounding_state = x;
+    return static_cast<uint32_t>(x >> 32);
+  }
+  inline uint32_t float_bits(float v)
+  {
+    uint32_t x;
+    std::memcpy(&x, &v, sizeof(x));
+    return x;
+  }
+  inline float bits_float(uint32_t x)
+  {
+    float v;
+    std::memcpy(&v, &x, sizeof(v));
+    return v;
+  }
+  inline float half_to_float(uint16_t h)
+  {
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    if (exp == 0x1F)   // inf, nan
+      return bits_float(sign | 0x7F800000 | (mant << 13));
+    if (exp == 0)
+    {
+      // ноль и денормализованные числа: mant * 2^-24
+      float v = mant * (1.0f / 16777216.0f);
+      return sign ? -v : v;
+    }
+    return bits_float(sign | ((exp + 127 - 15) << 23) | (mant << 13));
+#endif
+  }
+  // преобразование в fp16; к отбрасываемым младшим разрядам предварительно прибавляется round_bits
+  // (0 -- отбрасывание, половина младшего разряда -- округление к ближайшему, случайное значение -- стохастическое округление);
+  // перенос из отбрасываемых разрядов корректно распространяется в мантиссу и порядок
+  inline uint16_t float_to_half(float v, uint32_t round_bits)
+  {
+    uint32_t x = float_bits(v);
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t mag = x & 0x7FFFFFFF;
+    if (mag >= 0x7F800000)  // inf, nan
+      return sign | ((mag > 0x7F800000) ? 0x7E00 : 0x7C00);
+    int exp = static_cast<int>(mag >> 23) - 127 + 15;
+    if (exp >= 1)
+    {
+      // нормализованное fp16: отбрасываются 13 младших разрядов мантиссы float
+      mag += round_bits & 0x1FFF;
+      if (mag >= 0x477FF000)  // за пределами диапазона fp16 -- насыщение
+        return sign | 0x7BFF;
+      return sign | (((mag >> 23) - 127 + 15) << 10) | ((mag >> 13) & 0x3FF);
+    }
+    // денормализованное fp16 (или ноль): отбрасываются (14 - exp) младших разрядов 24-битной мантиссы
+    uint32_t shift = 14 - exp;
+    if (shift > 31) return sign;
+    uint32_t m = (mag & 0x7FFFFF) | 0x800000;
+    m += round_bits & ((1u << shift) - 1);
+    return sign | (m >> shift);
+  }
+  inline uint16_t float_to_half_nearest(float v)
+  {
+    uint32_t x = float_bits(v);
+    int exp = static_cast<int>((x & 0x7FFFFFFF) >> 23) - 127 + 15;
+    uint32_t shift = (exp >= 1) ? 13 : std::min<uint32_t>(14 - exp, 31);
+    return float_to_half(v, (1u << (shift - 1)) - 1);
+  }
+} // namespace weights_precision_internal
+
+
+// преобразование элемента хранения во float
+inline float to_float(float v)  { return v; }
+inline float to_float(bf16_t v) { return weights_precision_internal::bits_float(static_cast<uint32_t>(v.bits) << 16); }
+inline float to_float(fp16_t v) { return weights_precision_internal::half_to_float(v.bits); }
+
+// запись значения с округлением к ближайшему (используется при инициализации)
+inline void store_nearest(float& dst, float v)  { dst = v; }
+inline void store_nearest(bf16_t& dst, float v)
+{
+  uint32_t x = weights_precision_internal::float_bits(v);
+  if ((x & 0x7FFFFFFF) > 0x7F800000) { dst.bits = (x >> 16) | 0x40; return; }
+  dst.bits = (x + 0x7FFF + ((x >> 16) & 1)) >> 16;
+}
+inline void store_nearest(fp16_t& dst, float v) { dst.bits = weights_precision_internal::float_to_half_nearest(v); }
+
+// запись значения со стохастическим округлением (используется при обновлении весов)
+inline void store_stochastic(float& dst, float v) { dst = v; }
+inline void store_stochastic(bf16_t& dst, float v)
+{
+  uint32_t x = weights_precision_internal::float_bits(v);
+  if ((x & 0x7FFFFFFF) > 0x7F800000) { dst.bits = (x >> 16) | 0x40; return; }
+  dst.bits = (x + (weights_precision_internal::next_random() >> 16)) >> 16;
+}
+inline void store_stochastic(fp16_t& dst, float v) { dst.bits = weights_precision_internal::float_to_half(v, weights_precision_internal::next_random()); }
+
+// инициализация генератора стохастического округления для текущего потока
+inline void seed_weights_rounding(uint64_t seed)
+{
+  weights_precision_internal::rounding_state = 0x9E3779B97F4A7C15ULL ^ (seed * 0xBF58476D1CE4E5B9ULL + 1);
+}
+
+
+// ядра для float (в точности как в исходном коде word2vec)
+
+// acc += row
+inline void add_row(float* acc, const float* row, size_t n)
+{
+  std::transform(acc, acc+n, row, acc, std::plus<float>());
+}
+// скалярное произведение вектора h и строки весовой матрицы
+inline float dot_row(const float* h, const float* row, size_t n)
+{
+  return std::inner_product(h, h+n, row, 0.0);
+}
+// acc += g * row
+inline void axpy_row(float* acc, float g, const float* row, size_t n)
+{
+  std::transform(acc, acc+n, row, acc, [g](float a, float b) -> float {return a + g*b;});
+}
+// row += g * v
+inline void update_row(float* row, float g, const float* v, size_t n)
+{
+  std::transform(row, row+n, v, row, [g](float a, float b) -> float {return a + g*b;});
+}
+// row += v
+inline void add_to_row(float* row, const float* v, size_t n)
+{
+  std::transform(row, row+n, v, row, std::plus<float>());
+}
+// копирование строки во float-буфер
+inline void load_row(float* dst, const float* row, size_t n)
+{
+  std::copy(row, row+n, dst);
+}
+
+
+// ядра для 16-битных форматов хранения
+
+template <typename T>
+inline void add_row(float* acc, const T* row, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    acc[i] += to_float(row[i]);
+}
+template <typename T>
+inline float dot_row(const float* h, const T* row, size_t n)
+{
+  float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t i = 0;
+  for ( ; i + 8 <= n; i += 8)
+    for (size_t l = 0; l < 8; ++l)
+      acc[l] += h[i + l] * to_float(row[i + l]);
+  float result = 0;
+  for ( ; i < n; ++i)
+    result += h[i] * to_float(row[i]);
+  for (size_t l = 0; l < 8; ++l)
+    result += acc[l];
+  return result;
+}
+template <typename T>
+inline void axpy_row(float* acc, float g, const T* row, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    acc[i] += g * to_float(row[i]);
+}
+template <typename T>
+inline void update_row(T* row, float g, const float* v, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    store_stochastic(row[i], to_float(row[i]) + g * v[i]);
+}
+template <typename T>
+inline void add_to_row(T* row, const float* v, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    store_stochastic(row[i], to_float(row[i]) + v[i]);
+}
+template <typename T>
+inline void load_row(float* dst, const T* row, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    dst[i] = to_float(row[i]);
+}
+
+
+// упреждающая загрузка строки в кэш (для всех форматов хранения): строка будет прочитана через несколько сотен тактов,
+// и промах в память успевает совместиться с вычислениями над предыдущими строками
+const size_t PREFETCH_LINE_SIZE = 64;
+template <typename T>
+inline void prefetch_row(const T* row, size_t n)
+{
+  const char *first = reinterpret_cast<const char*>(row);
+  for (size_t offset = 0, bytes = n * sizeof(T); offset < bytes; offset += PREFETCH_LINE_SIZE)
+#if defined(_MSC_VER)
+    _mm_prefetch(first + offset, _MM_HINT_T0);
+#else
+    __builtin_prefetch(first + offset);
+#endif
+}
+
+
+#endif /* WEIGHTS_PRECISION_H_ */